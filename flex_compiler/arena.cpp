@@ -0,0 +1,137 @@
+// arena.cpp : bump-pointer allocation of the data structures of a compilation
+// Build with "g++ -c arena.cpp"
+
+#include "arena.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <new>
+#include <iostream>
+
+using namespace std;
+
+static const size_t ChunkSize=1<<20;				// 1 MB per chunk
+static const size_t Alignment=16;					// Enough for any type of the compiler (and the size of a Chunk)
+
+Arena CompilationArena={NULL, NULL, 0, 0, NULL, 0, 0, 0, 0};
+Arena PassArena={NULL, NULL, 0, 0, NULL, 0, 0, 0, 0};
+unsigned long HeapAllocations=0;
+
+// Every container that is not in an arena goes through here : counted for "--stats"
+void* operator new(size_t size) {
+	HeapAllocations++;
+	void* memory=malloc(size==0 ? 1 : size);
+	if (memory==NULL) {
+		throw bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+
+static Chunk* NewChunk(size_t size) {
+	size_t length=size>ChunkSize ? size : ChunkSize;
+	Chunk* chunk=(Chunk*) malloc(sizeof(Chunk)+length);	// Not operator new : the arena is not heap traffic of the compiler
+	if (chunk==NULL) {
+		cerr<<"Out of memory."<<endl;
+		exit(-1);
+	}
+	chunk->next=NULL;
+	chunk->size=length;
+	return chunk;
+}
+
+// Next 'size' bytes of the current chunk, or of the next one if it is full
+void* Allocate(Arena& arena, size_t size) {
+	size=(size+Alignment-1)/Alignment*Alignment;
+	if (arena.current==NULL) {
+		arena.first=arena.current=NewChunk(size);
+		arena.used=0;
+		arena.chunks++;
+	}
+	while (arena.used+size>arena.current->size) {	// Too small for this request : try the next chunk
+		if (arena.current->next==NULL) {
+			arena.current->next=NewChunk(size);
+			arena.chunks++;
+		}
+		arena.current=arena.current->next;
+		arena.used=0;
+	}
+	void* block=(char*) (arena.current+1)+arena.used;
+	arena.used+=size;
+	arena.allocations++;
+	arena.bytes+=size;
+	return block;
+}
+
+// Everything allocated so far is forgotten, the chunks are kept for the next compilation
+void ResetArena(Arena& arena) {
+	arena.current=arena.first;
+	arena.used=0;
+	arena.names=NULL;
+	arena.capacity=0;
+	arena.count=0;
+	arena.allocations=0;
+	arena.bytes=0;
+}
+
+static size_t Hash(const char* text) {				// FNV-1a
+	size_t hash=2166136261u;
+	for (; *text!='\0'; text++) {
+		hash=(hash^(unsigned char) *text)*16777619u;
+	}
+	return hash;
+}
+
+static const char* Copy(Arena& arena, const char* text) {
+	size_t length=strlen(text)+1;
+	char* copy=(char*) Allocate(arena, length);
+	memcpy(copy, text, length);
+	return copy;
+}
+
+// Identifiers are compared by pointer once interned
+const char* Intern(Arena& arena, const char* text) {
+	if (2*(arena.count+1)>arena.capacity) {			// Keep the table at most half full
+		size_t capacity=arena.capacity==0 ? 256 : 2*arena.capacity;
+		const char** names=(const char**) Allocate(arena, capacity*sizeof(const char*));
+		memset(names, 0, capacity*sizeof(const char*));
+		for (size_t i=0; i<arena.capacity; i++) {
+			if (arena.names[i]!=NULL) {
+				size_t slot=Hash(arena.names[i])&(capacity-1);
+				while (names[slot]!=NULL) {
+					slot=(slot+1)&(capacity-1);
+				}
+				names[slot]=arena.names[i];
+			}
+		}
+		arena.names=names;
+		arena.capacity=capacity;
+	}
+	size_t slot=Hash(text)&(arena.capacity-1);
+	while (arena.names[slot]!=NULL) {
+		if (strcmp(arena.names[slot], text)==0) {
+			return arena.names[slot];
+		}
+		slot=(slot+1)&(arena.capacity-1);
+	}
+	arena.names[slot]=Copy(arena, text);
+	arena.count++;
+	return arena.names[slot];
+}
+
+const char* Format(Arena& arena, const char* format, ...) {
+	char text[256];									// Labels and messages are short
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(text, sizeof(text), format, arguments);
+	va_end(arguments);
+	return Copy(arena, text);
+}
@@ -0,0 +1,68 @@
+// arena.h : bump-pointer allocation of the data structures of a compilation
+// Memory is taken from large chunks and is never freed piece by piece : ResetArena() forgets everything at once
+// and keeps the chunks, so the next compilation (compile server) reuses memory that is already mapped.
+// Identifiers, symbols, blocks, instructions and the containers inside them all live in CompilationArena,
+// so parsing a program does not call the general-purpose allocator. The tables of an optimization pass or of the
+// register allocator live in PassArena, which is reset when the pass ends.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+#include <map>
+#include <set>
+
+struct Chunk {										// Header of the memory obtained from malloc, kept until the end of the process
+	Chunk* next;
+	size_t size;									// Bytes after the header
+};
+
+struct Arena {
+	Chunk* first;
+	Chunk* current;									// Chunk being filled
+	size_t used;									// Bytes already allocated in that chunk
+	unsigned long chunks;							// Number of chunks
+	const char** names;								// Hash table of the interned identifiers (open addressing)
+	size_t capacity, count;							// Number of entries of the table, and of names in it
+	unsigned long allocations;						// Statistics since the last reset
+	unsigned long bytes;
+};
+
+extern Arena CompilationArena;						// Owns the data structures of the current compilation
+extern Arena PassArena;								// Owns the tables of the pass being run
+extern unsigned long HeapAllocations;				// Calls to operator new since the start of the process
+
+void* Allocate(Arena& arena, size_t size);
+void ResetArena(Arena& arena);
+const char* Intern(Arena& arena, const char* text);	// The same pointer for equal strings, until the next reset
+const char* Format(Arena& arena, const char* format, ...);	// sprintf into the arena
+
+// STL allocator taking its memory from an arena : deallocation is left to ResetArena()
+template<class T, Arena& A=CompilationArena> struct ArenaAllocator {
+	typedef T value_type;
+	template<class U> struct rebind {
+		typedef ArenaAllocator<U, A> other;
+	};
+	ArenaAllocator() {}
+	template<class U> ArenaAllocator(const ArenaAllocator<U, A>&) {}
+	T* allocate(size_t n) {
+		return (T*) Allocate(A, n*sizeof(T));
+	}
+	void deallocate(T*, size_t) {}
+};
+
+template<class T, class U, Arena& A> bool operator==(const ArenaAllocator<T, A>&, const ArenaAllocator<U, A>&) { return true; }
+template<class T, class U, Arena& A> bool operator!=(const ArenaAllocator<T, A>&, const ArenaAllocator<U, A>&) { return false; }
+
+// Containers of the compiler. Global ones must be emptied by assigning a new container before ResetArena().
+template<class T> using ArenaVector=std::vector<T, ArenaAllocator<T> >;
+template<class K, class V, class C=std::less<K> > using ArenaMap=std::map<K, V, C, ArenaAllocator<std::pair<const K, V> > >;
+
+// Containers of a pass : PassArena is reset after each optimization pass and after the code of each function
+template<class T> using PassVector=std::vector<T, ArenaAllocator<T, PassArena> >;
+template<class K, class V, class C=std::less<K> > using PassMap=std::map<K, V, C, ArenaAllocator<std::pair<const K, V>, PassArena> >;
+template<class K, class C=std::less<K> > using PassSet=std::set<K, C, ArenaAllocator<K, PassArena> >;
+template<class K, class C=std::less<K> > using ArenaSet=std::set<K, C, ArenaAllocator<K> >;
+
+#endif
@@ -0,0 +1,235 @@
+// cbackend.cpp : C99 code generated from the SSA intermediate representation
+// Build with "g++ -c cbackend.cpp"
+// "./compiler --emit=c < program.p > program.c" then "gcc -O2 program.c parallel.o -pthread" : gcc optimizes it.
+// The .data variables become static variables (v_name), the SSA values become locals (tNUMBER) of the function,
+// the blocks become labels and the branches gotos. A PHI has a second local (pNUMBER) written by its predecessors,
+// copied into the PHI at the start of its block, so the predecessors can read a PHI they give a new value to.
+// INTEGER and BOOLEAN values are unsigned 64-bit integers : FALSE is 0, TRUE is ~0, AND is a multiplication and OR
+// an addition, like in the assembly code. The comparisons of doubles are TRUE when a double is NaN, except > and >=.
+// The bodies of the PARALLEL FOR loops are static functions called by the runtime (parallel.c), and the REDUCE
+// variables are combined with the atomic builtins of gcc and clang.
+
+#include "ir.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+
+static const char* const CTypes[]={"u64", "u64", "double", "u64"};	// Type of the values of each TYPES
+static const char* const VariableTypes[]={"u64", "u64", "double", "unsigned char"};	// Type of the variables
+
+// A C expression for 'value' : integer constants are literals, doubles are written in hexadecimal so they are exact
+static string Value(Instruction* value) {
+	char text[64];
+	if (value->op!=OP_CONST) {
+		return "t"+to_string(value->id);
+	}
+	if (value->type!=DOUBLE) {
+		snprintf(text, sizeof(text), "%lluULL", value->imm);
+		return text;
+	}
+	double d;
+	memcpy(&d, &value->imm, sizeof(d));
+	if (isfinite(d)) {
+		snprintf(text, sizeof(text), "%a", d);
+	}
+	else {											// No literal for infinities and NaNs
+		snprintf(text, sizeof(text), "D(0x%llxULL)", value->imm);
+	}
+	return text;
+}
+
+// Before leaving 'block', give their value to the PHIs of its successors
+static void EmitPhiMoves(ostream& out, Block* block) {
+	for (size_t s=0; s<block->succs.size(); s++) {
+		Block* succ=block->succs[s];
+		size_t p=0;
+		while (succ->preds[p]!=block) {
+			p++;
+		}
+		for (size_t i=0; i<succ->phis.size(); i++) {
+			out<<"\tp"<<succ->phis[i]->id<<" = "<<Value(succ->phis[i]->args[p])<<";"<<endl;
+		}
+	}
+}
+
+static void EmitComparison(ostream& out, Instruction* instruction) {
+	static const char* const Operators[]={"==", "!=", "<", ">", "<=", ">="};
+	string a=Value(instruction->args[0]), b=Value(instruction->args[1]);
+	string comparison=a+" "+Operators[instruction->op-OP_EQU]+" "+b;
+	if (instruction->args[0]->type==DOUBLE) {		// Like ucomisd followed by sete, setne, setb, seta, setbe, setae
+		string unordered="isunordered("+a+", "+b+")";
+		switch (instruction->op) {
+			case OP_EQU: case OP_INF: case OP_INFE:
+				comparison="("+comparison+" || "+unordered+")";
+				break;
+			case OP_DIFF:
+				comparison="!("+a+" == "+b+" || "+unordered+")";
+				break;
+			default:
+				break;
+		}
+	}
+	out<<"\tt"<<instruction->id<<" = -(u64) ("<<comparison<<");"<<endl;	// 1 becomes TRUE
+}
+
+static void EmitDisplay(ostream& out, Instruction* instruction) {
+	string value=Value(instruction->args[0]);
+	switch (instruction->type) {
+		case INTEGER:
+			out<<"\tprintf(\"%llu\", "<<value<<");"<<endl;
+			break;
+		case BOOLEAN:
+			out<<"\tprintf(\"%s\", "<<value<<" ? \"TRUE\" : \"FALSE\");"<<endl;
+			break;
+		case CHAR:
+			out<<"\tprintf(\"%c\", (int) (unsigned char) "<<value<<");"<<endl;
+			break;
+		case DOUBLE:
+			out<<"\tprintf(\"%lf\", "<<value<<");"<<endl;
+			break;
+		default:
+			break;
+	}
+	out<<"\tputchar('\\n');"<<endl;
+}
+
+// A thread combines its part of a REDUCE variable with the static variable
+static void EmitReduce(ostream& out, Instruction* instruction) {
+	string variable="v_"+string(instruction->var), value=Value(instruction->args[0]);
+	if (instruction->type!=DOUBLE && (instruction->imm==OP_ADD || instruction->imm==OP_OR)) {
+		out<<"\t__atomic_fetch_add(&"<<variable<<", "<<value<<", __ATOMIC_SEQ_CST);"<<endl;
+		return;
+	}
+	const char* op=instruction->imm==OP_ADD ? "+" : "*";
+	out<<"\t{"<<endl;
+	out<<"\t\t"<<CTypes[instruction->type]<<" old = "<<variable<<", new;"<<endl;
+	out<<"\t\tdo {"<<endl;
+	out<<"\t\t\tnew = old "<<op<<" "<<value<<";"<<endl;
+	out<<"\t\t} while (!__atomic_compare_exchange(&"<<variable<<", &old, &new, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));"<<endl;
+	out<<"\t}"<<endl;
+}
+
+// 'next' is the block that follows : there is no goto to it
+static void EmitInstruction(ostream& out, Instruction* instruction, Block* next) {
+	static const char* const Operators[]={"+", "-", "*", "/", "%", "*", "+"};	// ADD, SUB, MUL, DIV, MOD, AND, OR
+	Block* block=instruction->block;
+	string result="\tt"+to_string(instruction->id)+" = ";
+	switch (instruction->op) {
+		case OP_CONST:								// Literals
+		case OP_PHI:
+			break;
+		case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD: case OP_AND: case OP_OR:
+			out<<result<<Value(instruction->args[0])<<" "<<Operators[instruction->op-OP_ADD]<<" "<<Value(instruction->args[1])<<";"<<endl;
+			break;
+		case OP_EQU: case OP_DIFF: case OP_INF: case OP_SUP: case OP_INFE: case OP_SUPE:
+			EmitComparison(out, instruction);
+			break;
+		case OP_SELECT:
+			out<<result<<Value(instruction->args[0])<<" ? "<<Value(instruction->args[1])<<" : "<<Value(instruction->args[2])<<";"<<endl;
+			break;
+		case OP_LOAD:
+			out<<result<<"v_"<<instruction->var<<";"<<endl;
+			break;
+		case OP_ARG:
+			out<<result<<(instruction->imm==0 ? "first" : "end")<<";"<<endl;
+			break;
+		case OP_STORE:
+			out<<"\tv_"<<instruction->var<<" = "<<Value(instruction->args[0])<<";"<<endl;
+			break;
+		case OP_DISPLAY:
+			EmitDisplay(out, instruction);
+			break;
+		case OP_PARALLEL:
+			out<<"\tpascal_parallel_for("<<instruction->var<<", "<<Value(instruction->args[0])<<", "<<Value(instruction->args[1])<<");"<<endl;
+			break;
+		case OP_REDUCE:
+			EmitReduce(out, instruction);
+			break;
+		case OP_JUMP:
+			EmitPhiMoves(out, block);
+			if (block->succs[0]!=next) {
+				out<<"\tgoto "<<block->succs[0]->label<<";"<<endl;
+			}
+			break;
+		case OP_BRANCH:
+			EmitPhiMoves(out, block);
+			out<<"\tif ("<<Value(instruction->args[0])<<") goto "<<block->succs[0]->label<<";"<<endl;
+			if (block->succs[1]!=next) {
+				out<<"\tgoto "<<block->succs[1]->label<<";"<<endl;
+			}
+			break;
+		case OP_RET:
+			out<<(CurrentFunction==Functions[0] ? "\treturn 0;" : "\treturn;")<<endl;
+			break;
+		default:
+			break;
+	}
+}
+
+// The selected function : its locals, then its blocks
+static void EmitFunction(ostream& out) {
+	if (CurrentFunction==Functions[0]) {
+		out<<"int main(void) {"<<endl;
+	}
+	else {
+		out<<"static void "<<CurrentFunction->label<<"(u64 first, u64 end) {"<<endl;
+	}
+	for (size_t b=0; b<Blocks.size(); b++) {
+		for (size_t i=0; i<Blocks[b]->phis.size(); i++) {
+			Instruction* phi=Blocks[b]->phis[i];
+			out<<"\t"<<CTypes[phi->type]<<" t"<<phi->id<<", p"<<phi->id<<";\t/* "<<phi->var<<" */"<<endl;
+		}
+		for (size_t i=0; i<Blocks[b]->code.size(); i++) {
+			Instruction* instruction=Blocks[b]->code[i];
+			if (HasValue(instruction->op) && instruction->op!=OP_CONST) {
+				out<<"\t"<<CTypes[instruction->type]<<" t"<<instruction->id<<";"<<endl;
+			}
+		}
+	}
+	for (size_t b=0; b<Blocks.size(); b++) {
+		Block* block=Blocks[b];
+		out<<block->label<<":"<<endl;
+		for (size_t i=0; i<block->phis.size(); i++) {
+			out<<"\tt"<<block->phis[i]->id<<" = p"<<block->phis[i]->id<<";"<<endl;
+		}
+		for (size_t i=0; i<block->code.size(); i++) {
+			EmitInstruction(out, block->code[i], b+1<Blocks.size() ? Blocks[b+1] : NULL);
+		}
+	}
+	out<<"}"<<endl;
+}
+
+void GenerateC(ostream& out) {
+	Function* selected=CurrentFunction;
+	out<<"/* This code was produced by the compiler made by Elliot Pozucek */"<<endl;
+	out<<"#include <stdio.h>"<<endl;
+	out<<"#include <string.h>"<<endl;
+	out<<"#include <math.h>"<<endl;
+	out<<endl;
+	out<<"typedef unsigned long long u64;"<<endl;
+	out<<endl;
+	out<<"static inline double D(u64 bits) {\t/* The double whose 64 bits are 'bits' */"<<endl;
+	out<<"\tdouble d;"<<endl;
+	out<<"\tmemcpy(&d, &bits, sizeof(d));"<<endl;
+	out<<"\treturn d;"<<endl;
+	out<<"}"<<endl;
+	out<<endl;
+	for (size_t v=0; v<Variables.size(); v++) {
+		out<<"static "<<VariableTypes[Variables[v].second]<<" v_"<<Variables[v].first<<";"<<endl;
+	}
+	if (Functions.size()>1) {						// Bodies of the PARALLEL FOR loops
+		out<<endl;
+		out<<"void pascal_parallel_for(void (*body)(u64, u64), u64 first, u64 end);\t/* parallel.c */"<<endl;
+		for (size_t f=1; f<Functions.size(); f++) {
+			out<<"static void "<<Functions[f]->label<<"(u64 first, u64 end);"<<endl;
+		}
+	}
+	for (size_t f=0; f<Functions.size(); f++) {
+		out<<endl;
+		SelectFunction(Functions[f]);
+		EmitFunction(out);
+	}
+	SelectFunction(selected);
+}
@@ -0,0 +1,104 @@
+// client.cpp : thin client of the compile server (see server.cpp)
+// Build with "g++ -o client client.cpp"
+// "./client [--socket path] [options] < program.p > program.s" behaves like "./compiler [options] < program.p > program.s"
+// while the compilation is done by "./compiler --server [path]".
+
+#include "server.h"
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+static bool WriteAll(int fd, const char* data, size_t size) {
+	while (size>0) {
+		ssize_t length=write(fd, data, size);
+		if (length<0) {
+			if (errno==EINTR) continue;
+			return false;
+		}
+		data+=length;
+		size-=length;
+	}
+	return true;
+}
+
+static bool ReadExactly(int fd, char* data, size_t size) {
+	while (size>0) {
+		ssize_t length=read(fd, data, size);
+		if (length<0 && errno==EINTR) continue;
+		if (length<=0) return false;
+		data+=length;
+		size-=length;
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	const char* path=DEFAULT_SOCKET;
+	string options;
+	int first=1;
+	if (argc>2 && strcmp(argv[1], "--socket")==0) {
+		path=argv[2];
+		first=3;
+	}
+	options=to_string(argc-first)+"\n";				// The other arguments are options of the compiler
+	for (int i=first; i<argc; i++) {				// Ended by a NUL character : they may contain blanks
+		options+=argv[i];
+		options+='\0';
+	}
+
+	struct sockaddr_un address;
+	int server=socket(AF_UNIX, SOCK_STREAM, 0);
+	memset(&address, 0, sizeof(address));
+	address.sun_family=AF_UNIX;
+	strncpy(address.sun_path, path, sizeof(address.sun_path)-1);
+	if (server<0 || connect(server, (struct sockaddr*) &address, sizeof(address))<0) {
+		fprintf(stderr, "Cannot connect to the compile server on %s: %s\n", path, strerror(errno));
+		fprintf(stderr, "Start it with: ./compiler --server %s\n", path);
+		return -1;
+	}
+
+	char buffer[65536];								// Send the options, then the program
+	ssize_t length;
+	bool sent=WriteAll(server, options.data(), options.size());
+	while (sent && (length=read(0, buffer, sizeof(buffer)))!=0) {
+		if (length<0) {
+			if (errno==EINTR) continue;
+			break;
+		}
+		sent=WriteAll(server, buffer, length);
+	}
+	shutdown(server, SHUT_WR);						// End of the program
+
+	int status=-1;
+	char header[5];
+	while (ReadExactly(server, header, sizeof(header))) {	// Frames of the answer
+		uint32_t size;
+		memcpy(&size, header+1, sizeof(size));
+		size=ntohl(size);
+		string data(size, '\0');
+		if (!ReadExactly(server, &data[0], size)) {
+			break;
+		}
+		switch (header[0]) {
+			case OUTPUT:
+				fwrite(data.data(), 1, data.size(), stdout);
+				break;
+			case DIAGNOSTICS:
+				fwrite(data.data(), 1, data.size(), stderr);
+				break;
+			case STATUS:
+				status=atoi(data.c_str());
+				break;
+		}
+	}
+	close(server);
+	return status;
+}
@@ -0,0 +1,1152 @@
+// codegen.cpp : 64-bit 80x86 assembly code (AT&T) generated from the SSA intermediate representation
+// Build with "g++ -c codegen.cpp"
+// Values are kept in registers by a linear-scan allocator (Poletto and Sarkar, "Linear Scan Register Allocation") :
+// each value is live over an interval of positions of the layout, and the intervals are given registers in order.
+// Integer, BOOLEAN and CHAR values use the registers that printf must preserve (%rbx, %r12 to %r15), doubles
+// use %xmm2 to %xmm15, saved around the calls. Integer constants are immediate operands. When the registers are
+// all taken, the value with the fewest uses (weighted by the depth of the loops around them) goes to its 8-byte
+// slot in the stack frame of main, from a point where every execution passes once, outside the loops : the values
+// of the loops being executed keep their registers. Variables are only written to .data at the end of the program.
+// The body of each PARALLEL FOR is a function of its own, allocated and generated after main : the runtime
+// (parallel.c) calls it with the first iteration in %rdi and the end of its range in %rsi.
+
+#include "ir.h"
+#include <cstring>
+#include <algorithm>
+#include <queue>
+
+using namespace std;
+
+struct Interval {
+	Instruction* value;
+	size_t start, end;								// First and last positions where the value is live
+	PassVector<pair<size_t, double> > uses;			// Position and weight of the definitions and uses
+	int reg;										// In Registers or VectorRegisters, -1 when the value is in its slot
+	size_t split;									// Position from which the value is read from its slot
+	long slot;										// Offset from %rbp, 0 if the value never leaves its register
+};
+
+struct VariableRange {								// -g : where a variable is, from a position of a function to another one
+	size_t function;
+	size_t variable;								// In Variables
+	TYPES type;
+	size_t start, end;								// The variable is there from 'start' to 'end' (excluded)
+	int reg;										// In Registers or VectorRegisters, -1 when it is in a slot
+	long slot;
+};
+
+struct LoopRange {									// A loop is a range of positions : the layout keeps its blocks together
+	size_t start, end;
+	int parent;										// Enclosing loop, -1 if none
+};
+
+static const char* const Registers[]={"%rbx", "%r12", "%r13", "%r14", "%r15"};	// Preserved by printf and putchar
+static const char* const VectorRegisters[]={"%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7", "%xmm8",
+	"%xmm9", "%xmm10", "%xmm11", "%xmm12", "%xmm13", "%xmm14", "%xmm15"};		// %xmm0 and %xmm1 are scratch registers
+static const int RegisterCount[2]={5, 14};			// Integers, doubles
+static const size_t NoSplit=(size_t) -1;
+
+static PassVector<Interval> Intervals;
+static PassMap<Instruction*, size_t> Number;		// Interval of each value
+static PassMap<Instruction*, size_t> Position;		// Position of each instruction (PHIs : first position of their block)
+static PassMap<Block*, size_t> Index;				// Index of each block in the layout
+static PassVector<size_t> First, Last;				// Position of the PHIs and of the terminator of each block
+static PassVector<LoopRange> Loops;					// Sorted by start
+static PassVector<int> Innermost;					// Innermost loop around each block, -1 if none
+static PassVector<int> Depth;						// Number of loops around each block
+static PassVector<size_t> SplitPoints;				// First positions of the blocks executed once by every execution
+static PassVector<PassVector<size_t> > SplitAt;		// Intervals written to their slot at the start of each block
+static PassMap<Instruction*, PassVector<size_t> > Saved;	// Vector registers saved around the calls of a DISPLAY or a PARALLEL
+static PassVector<pair<const char*, long> > CalleeSaved;	// Registers of the caller of the function used, and where they are saved
+static const size_t InstructionBytes=12;			// Rough size of the code of an IR instruction
+static PassVector<const char*> Alignment;			// Directive placed before each block of the layout, if any
+static PassSet<size_t> DebugLabels;					// -g : positions where a variable changes place, labelled .LposF_P
+static size_t FunctionNumber;						// Of the function being generated, in the labels of its positions
+static ArenaVector<VariableRange> VariableRanges;	// -g : of every function, described by EmitDebugInfo
+
+// Values that are computed and kept somewhere : integer constants are only immediate operands
+static bool HasHome(Instruction* value) {
+	return HasValue(value->op) && !(value->op==OP_CONST && value->type!=DOUBLE);
+}
+
+static bool IsRegister(const string& location) {
+	return location[0]=='%';
+}
+
+static bool IsVector(const string& location) {
+	return location.compare(0, 4, "%xmm")==0;
+}
+
+static string Slot(long offset) {
+	return to_string(offset)+"(%rbp)";
+}
+
+static string RegisterName(TYPES type, int reg) {
+	return type==DOUBLE ? VectorRegisters[reg] : Registers[reg];
+}
+
+static string RegisterName(const Interval& interval) {
+	return RegisterName(interval.value->type, interval.reg);
+}
+
+// Where 'value' is at 'position' : a register, a slot, or an immediate for an integer constant
+static string Location(Instruction* value, size_t position) {
+	if (!HasHome(value)) {
+		return "$"+to_string((long long) value->imm);
+	}
+	const Interval& interval=Intervals[Number.at(value)];
+	if (interval.reg>=0 && position<interval.split) {
+		return RegisterName(interval);
+	}
+	return Slot(interval.slot);
+}
+
+// A source operand for 'value' : constants that are not sign-extended 32-bit immediates are loaded into 'scratch'
+static string Operand(ostream& out, Instruction* value, size_t position, const char* scratch) {
+	string location=Location(value, position);
+	long long imm=(long long) value->imm;
+	if (location[0]=='$' && imm!=(long long) (int) imm) {
+		out<<"\tmovabsq\t"<<location<<", "<<scratch<<endl;
+		return scratch;
+	}
+	return location;
+}
+
+// Copy 64 bits, through %rax from memory to memory
+static void Move(ostream& out, string from, const string& to) {
+	if (from==to) {
+		return;
+	}
+	if (!IsRegister(from) && !IsRegister(to) && from[0]!='$') {
+		out<<"\tmovq\t"<<from<<", %rax"<<endl;
+		from="%rax";
+	}
+	if (IsVector(from) && IsVector(to)) {
+		out<<"\tmovapd\t"<<from<<", "<<to<<endl;
+	}
+	else {
+		out<<"\tmovq\t"<<from<<", "<<to<<endl;
+	}
+}
+
+// Positions of the instructions in the layout, and loops as ranges of positions
+static void NumberPositions(void) {
+	size_t position=0;
+	Position.clear();
+	Index.clear();
+	First.assign(Blocks.size(), 0);
+	Last.assign(Blocks.size(), 0);
+	for (size_t b=0; b<Blocks.size(); b++) {
+		Index[Blocks[b]]=b;
+		First[b]=position;
+		for (size_t i=0; i<Blocks[b]->phis.size(); i++) {
+			Position[Blocks[b]->phis[i]]=position;
+		}
+		position++;
+		for (size_t i=0; i<Blocks[b]->code.size(); i++) {
+			Position[Blocks[b]->code[i]]=position++;
+		}
+		Last[b]=position-1;
+	}
+	PassMap<size_t, size_t> back;					// First block of each loop, and last position of its back edges
+	for (size_t b=0; b<Blocks.size(); b++) {
+		for (size_t s=0; s<Blocks[b]->succs.size(); s++) {
+			size_t target=Index[Blocks[b]->succs[s]];
+			if (target<=b) {
+				back[target]=max(back[target], Last[b]);
+			}
+		}
+	}
+	Loops.clear();
+	Innermost.assign(Blocks.size(), -1);
+	Depth.assign(Blocks.size(), 0);
+	PassVector<int> open;							// Loops around the current block, innermost last
+	PassMap<size_t, size_t>::iterator loop=back.begin();
+	for (size_t b=0; b<Blocks.size(); b++) {
+		while (!open.empty() && Loops[open.back()].end<First[b]) {
+			open.pop_back();
+		}
+		if (loop!=back.end() && loop->first==b) {
+			LoopRange range={First[b], loop->second, open.empty() ? -1 : open.back()};
+			Loops.push_back(range);
+			open.push_back(Loops.size()-1);
+			loop++;
+		}
+		Innermost[b]=open.empty() ? -1 : open.back();
+		Depth[b]=open.size();
+	}
+}
+
+// A use in a loop costs as much as 8 uses out of it
+static double Weight(size_t b) {
+	double weight=1;
+	for (int d=0; d<Depth[b] && d<6; d++) {
+		weight*=8;
+	}
+	return weight;
+}
+
+// The value is used (or written) at 'position', in the b-th block. Used in a loop where it is not defined,
+// it is needed by every iteration : it stays live over the whole loop. Used in the loop where it is defined but
+// laid out before its definition (the test of a rotated loop is after the body), it comes from the previous
+// iteration through the back edge : it also stays live over the whole loop.
+static void Use(Interval& interval, size_t position, size_t b) {
+	size_t definition=Position.at(interval.value);
+	interval.uses.push_back(make_pair(position, Weight(b)));
+	interval.start=min(interval.start, position);
+	interval.end=max(interval.end, position);
+	for (int l=Innermost[b]; l>=0; l=Loops[l].parent) {
+		bool inside=definition>=Loops[l].start && definition<=Loops[l].end;
+		if (inside && definition<=position) {
+			break;
+		}
+		interval.start=min(interval.start, Loops[l].start);
+		interval.end=max(interval.end, Loops[l].end);
+		if (inside) {
+			break;
+		}
+	}
+}
+
+// The predecessors of a block write its PHIs just before their terminator
+static void BuildIntervals(void) {
+	Intervals.clear();
+	Number.clear();
+	for (size_t b=0; b<Blocks.size(); b++) {
+		for (size_t i=0; i<Blocks[b]->phis.size()+Blocks[b]->code.size(); i++) {
+			Instruction* value=i<Blocks[b]->phis.size() ? Blocks[b]->phis[i] : Blocks[b]->code[i-Blocks[b]->phis.size()];
+			if (HasHome(value)) {
+				Interval interval;
+				interval.value=value;
+				interval.start=interval.end=Position.at(value);
+				interval.reg=-1;
+				interval.split=NoSplit;
+				interval.slot=0;
+				Number[value]=Intervals.size();
+				Intervals.push_back(interval);
+				if (value->op!=OP_PHI) {
+					Use(Intervals.back(), Position.at(value), b);
+				}
+			}
+		}
+	}
+	for (size_t b=0; b<Blocks.size(); b++) {
+		Block* block=Blocks[b];
+		for (size_t i=0; i<block->code.size(); i++) {
+			for (size_t a=0; a<block->code[i]->args.size(); a++) {
+				if (HasHome(block->code[i]->args[a])) {
+					Use(Intervals[Number.at(block->code[i]->args[a])], Position.at(block->code[i]), b);
+				}
+			}
+		}
+		for (size_t s=0; s<block->succs.size(); s++) {
+			Block* succ=block->succs[s];
+			size_t p=find(succ->preds.begin(), succ->preds.end(), block)-succ->preds.begin();
+			for (size_t i=0; i<succ->phis.size(); i++) {
+				Use(Intervals[Number.at(succ->phis[i])], Last[b], b);
+				if (HasHome(succ->phis[i]->args[p])) {
+					Use(Intervals[Number.at(succ->phis[i]->args[p])], Last[b], b);
+				}
+			}
+		}
+	}
+}
+
+// Blocks out of any loop that every execution goes through : a value can move from its register to its slot there
+static void FindSplitPoints(void) {
+	Block* exit=NULL;
+	ComputeDominators();
+	for (size_t b=0; b<Blocks.size(); b++) {
+		if (Blocks[b]->code.back()->op==OP_RET) {
+			exit=Blocks[b];
+		}
+	}
+	SplitPoints.clear();
+	for (size_t b=0; b<Blocks.size(); b++) {
+		if (Depth[b]==0 && exit!=NULL && Dominates(Blocks[b], exit)) {
+			SplitPoints.push_back(First[b]);
+		}
+	}
+}
+
+static double CostFrom(const Interval& interval, size_t position) {
+	double cost=0;
+	for (size_t u=0; u<interval.uses.size(); u++) {
+		if (interval.uses[u].first>=position) {
+			cost+=interval.uses[u].second;
+		}
+	}
+	return cost;
+}
+
+static bool StartsBefore(const Interval* a, const Interval* b) {
+	return a->start<b->start;
+}
+
+// Linear scan : the intervals are visited by increasing start, the registers of the intervals that ended are free again
+static void ScanIntervals(void) {
+	PassVector<Interval*> order;
+	for (size_t i=0; i<Intervals.size(); i++) {
+		order.push_back(&Intervals[i]);
+	}
+	stable_sort(order.begin(), order.end(), StartsBefore);
+	PassVector<Interval*> active[2];				// Intervals in a register, for each kind of register
+	for (size_t i=0; i<order.size(); i++) {
+		Interval* current=order[i];
+		PassVector<Interval*>& live=active[current->value->type==DOUBLE];
+		PassVector<bool> busy(RegisterCount[current->value->type==DOUBLE], false);
+		for (size_t a=0; a<live.size(); ) {
+			if (live[a]->end<current->start) {
+				live.erase(live.begin()+a);
+			}
+			else {
+				busy[live[a]->reg]=true;
+				a++;
+			}
+		}
+		size_t r=find(busy.begin(), busy.end(), false)-busy.begin();
+		if (r<busy.size()) {
+			current->reg=r;
+			live.push_back(current);
+			continue;
+		}
+		// No free register : the cheapest value goes to its slot
+		PassVector<size_t>::iterator point=upper_bound(SplitPoints.begin(), SplitPoints.end(), current->start);
+		size_t split=point==SplitPoints.begin() ? 0 : *(point-1);
+		double cheapest=CostFrom(*current, 0);
+		size_t victim=live.size();
+		for (size_t a=0; a<live.size(); a++) {
+			size_t from=live[a]->start<split ? split : 0;		// Kept in its register before the split point
+			double cost=CostFrom(*live[a], from)+(from>0 ? 1 : 0);
+			if (cost<cheapest) {
+				cheapest=cost;
+				victim=a;
+			}
+		}
+		if (victim==live.size()) {
+			continue;
+		}
+		live[victim]->split=live[victim]->start<split ? split : 0;
+		current->reg=live[victim]->reg;
+		live[victim]=current;
+	}
+}
+
+static bool StartsEarlier(size_t a, size_t b) {
+	return Intervals[a].start<Intervals[b].start;
+}
+
+// Values out of their register are given a slot : after the allocation, and around the calls for vector registers
+static long AllocateSlots(void) {
+	PassMap<size_t, size_t> block;					// Block of each split point
+	for (size_t b=0; b<Blocks.size(); b++) {
+		block[First[b]]=b;
+	}
+	PassVector<size_t> vectors;						// Intervals in a vector register, by increasing start
+	for (size_t i=0; i<Intervals.size(); i++) {
+		if (Intervals[i].reg>=0 && Intervals[i].value->type==DOUBLE) {
+			vectors.push_back(i);
+		}
+	}
+	sort(vectors.begin(), vectors.end(), StartsEarlier);
+	PassVector<bool> saved(Intervals.size(), false);
+	PassVector<size_t> live;
+	size_t next=0;
+	Saved.clear();
+	for (size_t b=0; b<Blocks.size(); b++) {
+		for (size_t i=0; i<Blocks[b]->code.size(); i++) {
+			Instruction* call=Blocks[b]->code[i];
+			size_t position=Position.at(call);
+			if (call->op!=OP_DISPLAY && call->op!=OP_PARALLEL) {
+				continue;
+			}
+			while (next<vectors.size() && Intervals[vectors[next]].start<position) {
+				live.push_back(vectors[next++]);
+			}
+			for (size_t l=0; l<live.size(); ) {
+				if (Intervals[live[l]].end<=position || Intervals[live[l]].split<=position) {
+					live.erase(live.begin()+l);		// No longer needed in its register
+				}
+				else {
+					Saved[call].push_back(live[l]);
+					saved[live[l]]=true;
+					l++;
+				}
+			}
+		}
+	}
+
+	long size=0;
+	SplitAt.assign(Blocks.size(), PassVector<size_t>());
+	for (size_t i=0; i<Intervals.size(); i++) {
+		Interval& interval=Intervals[i];
+		if (interval.reg<0 || interval.split!=NoSplit || saved[i]) {
+			size+=8;
+			interval.slot=-size;
+		}
+		if (interval.reg>=0 && interval.split!=NoSplit && interval.start<interval.split) {
+			SplitAt[block.at(interval.split)].push_back(i);
+		}
+	}
+	PassVector<bool> used(RegisterCount[0], false);
+	for (size_t i=0; i<Intervals.size(); i++) {
+		if (Intervals[i].reg>=0 && Intervals[i].value->type!=DOUBLE) {
+			used[Intervals[i].reg]=true;
+		}
+	}
+	CalleeSaved.clear();
+	for (int r=0; r<RegisterCount[0]; r++) {
+		if (used[r]) {
+			size+=8;
+			CalleeSaved.push_back(make_pair(Registers[r], -size));
+		}
+	}
+	return (size+15)/16*16;							// printf expects a 16-byte aligned stack
+}
+
+// -g : where each variable is. A value is the value of its variable from its definition (from the start of the loop
+// for a PHI used before its block in the layout, from the block of the assignment for a copy) to the end of its
+// interval. Where the values of a variable overlap, the one defined last is its current value. It is in its
+// register, then in its slot from its split. A variable whose value is an integer constant is nowhere : the debugger
+// shows it as optimized out.
+static void LocateVariables(void) {
+	size_t first=VariableRanges.size();				// Ranges of the previous functions before it
+	PassMap<const char*, PassVector<pair<size_t, size_t> >, NameOrder> values;	// Start and interval of the values of each variable
+	size_t ret=Last[Blocks.size()-1];				// The callee-saved registers are restored there
+	for (size_t a=0; a<CurrentFunction->assignments.size(); a++) {
+		const Assignment& assignment=CurrentFunction->assignments[a];
+		Instruction* value=Resolve(assignment.value);
+		PassMap<Instruction*, size_t>::iterator number=Number.find(value);
+		if (number==Number.end()) {				// Integer constant, or removed
+			continue;
+		}
+		const Interval& interval=Intervals[number->second];
+		size_t start=Position.at(value)+1;
+		if (value->op==OP_PHI) {
+			size_t b=Index.at(value->block);
+			start=First[b];
+			for (int l=Innermost[b]; l>=0; l=Loops[l].parent) {
+				if (Loops[l].start>=interval.start) {
+					start=min(start, Loops[l].start);
+				}
+			}
+		}
+		PassMap<Block*, size_t>::iterator block=Index.find(assignment.block);
+		if (block!=Index.end() && assignment.block!=value->block) {	// Copy of a value computed before
+			start=max(start, First[block->second]);
+		}
+		if (start<=interval.end && start<ret) {
+			values[assignment.var].push_back(make_pair(start, number->second));
+		}
+	}
+	for (size_t variable=0; variable<Variables.size(); variable++) {
+		PassMap<const char*, PassVector<pair<size_t, size_t> >, NameOrder>::iterator it=values.find(Variables[variable].first);
+		if (it==values.end()) {
+			continue;
+		}
+		PassVector<pair<size_t, size_t> >& list=it->second;
+		PassVector<size_t> changes;					// Positions where the place of the variable may change
+		sort(list.begin(), list.end());
+		for (size_t v=0; v<list.size(); v++) {
+			const Interval& interval=Intervals[list[v].second];
+			changes.push_back(list[v].first);
+			changes.push_back(min(interval.end+1, ret));
+			if (interval.reg>=0 && interval.split>list[v].first && interval.split<=interval.end) {
+				changes.push_back(interval.split);
+			}
+		}
+		sort(changes.begin(), changes.end());
+		changes.erase(unique(changes.begin(), changes.end()), changes.end());
+		priority_queue<pair<size_t, size_t>, PassVector<pair<size_t, size_t> > > current;	// Values started, the last one on top
+		size_t next=0;
+		for (size_t c=0; c+1<changes.size(); c++) {
+			size_t position=changes[c];
+			while (next<list.size() && list[next].first<=position) {
+				current.push(make_pair(list[next].first, list[next].second));
+				next++;
+			}
+			while (!current.empty() && Intervals[current.top().second].end<position) {
+				current.pop();
+			}
+			if (current.empty()) {
+				continue;
+			}
+			const Interval& interval=Intervals[current.top().second];
+			int reg=interval.reg>=0 && position<interval.split ? interval.reg : -1;
+			VariableRange range={FunctionNumber, variable, interval.value->type, position, changes[c+1], reg, reg<0 ? interval.slot : 0};
+			if (VariableRanges.size()>first) {		// Continues the previous range ?
+				VariableRange& previous=VariableRanges.back();
+				if (previous.variable==range.variable && previous.end==range.start
+					&& previous.reg==range.reg && previous.slot==range.slot && previous.type==range.type) {
+					previous.end=range.end;
+					continue;
+				}
+			}
+			VariableRanges.push_back(range);
+		}
+	}
+	for (size_t r=first; r<VariableRanges.size(); r++) {
+		DebugLabels.insert(VariableRanges[r].start);
+		DebugLabels.insert(VariableRanges[r].end);
+	}
+}
+
+// Before leaving the b-th block, give their value to the PHIs of its successors (a conditional branch never goes
+// to a block with PHIs). The copies are made as if in parallel : a PHI may receive the value of another one,
+// which is read before it is overwritten. A cycle of copies (a, b := b, a) goes through a scratch register.
+static void EmitPhiMoves(ostream& out, size_t b) {
+	struct Copy {
+		string to, from;
+		Instruction* value;
+	};
+	Block* block=Blocks[b];
+	size_t position=Last[b];
+	vector<Copy> copies;
+	for (size_t s=0; s<block->succs.size(); s++) {
+		Block* succ=block->succs[s];
+		size_t p=find(succ->preds.begin(), succ->preds.end(), block)-succ->preds.begin();
+		for (size_t i=0; i<succ->phis.size(); i++) {
+			Copy copy={Location(succ->phis[i], position), Location(succ->phis[i]->args[p], position), succ->phis[i]->args[p]};
+			if (copy.to!=copy.from) {
+				copies.push_back(copy);
+			}
+		}
+	}
+	while (!copies.empty()) {
+		size_t c=0;
+		for (; c<copies.size(); c++) {				// A copy whose destination is no longer read
+			size_t r=0;
+			while (r<copies.size() && (r==c || copies[r].from!=copies[c].to)) {
+				r++;
+			}
+			if (r==copies.size()) {
+				break;
+			}
+		}
+		if (c==copies.size()) {
+			string scratch=copies[0].value->type==DOUBLE ? "%xmm1" : "%rcx";
+			Move(out, copies[0].to, scratch);
+			for (size_t r=1; r<copies.size(); r++) {
+				if (copies[r].from==copies[0].to) {
+					copies[r].from=scratch;
+				}
+			}
+			c=0;
+		}
+		string from=copies[c].from==Location(copies[c].value, position) ? Operand(out, copies[c].value, position, "%rax") : copies[c].from;
+		Move(out, from, copies[c].to);
+		copies.erase(copies.begin()+c);
+	}
+}
+
+static void EmitArithmetic(ostream& out, Instruction* instruction) {
+	size_t position=Position.at(instruction);
+	string result=Location(instruction, position);
+	if (instruction->type==DOUBLE) {
+		const char* mnemonic=NULL;
+		switch (instruction->op) {
+			case OP_ADD: mnemonic="addsd"; break;
+			case OP_SUB: mnemonic="subsd"; break;
+			case OP_MUL: mnemonic="mulsd"; break;
+			case OP_DIV: mnemonic="divsd"; break;
+			default: break;
+		}
+		string b=Location(instruction->args[1], position);
+		string work=IsVector(result) && result!=b ? result : "%xmm0";
+		Move(out, Location(instruction->args[0], position), work);
+		out<<"\t"<<mnemonic<<"\t"<<b<<", "<<work<<endl;
+		Move(out, work, result);
+		return;
+	}
+	string b=Operand(out, instruction->args[1], position, "%rcx");
+	string a=Operand(out, instruction->args[0], position, "%rax");
+	if (instruction->op==OP_DIV || instruction->op==OP_MOD) {
+		if (b[0]=='$') {
+			Move(out, b, "%rcx");					// No immediate divisor
+			b="%rcx";
+		}
+		Move(out, a, "%rax");
+		out<<"\tmovq\t$0, %rdx"<<endl;				// Higher part of numerator set to 0
+		out<<"\tdivq\t"<<b<<endl;					// Quotient goes to %rax, remainder to %rdx
+		Move(out, instruction->op==OP_MOD ? "%rdx" : "%rax", result);
+		return;
+	}
+	string work=IsRegister(result) && result!=b ? result : "%rax";
+	Move(out, a, work);
+	switch (instruction->op) {
+		case OP_ADD:
+			out<<"\taddq\t"<<b<<", "<<work<<"\t\t# ADD"<<endl;
+			break;
+		case OP_OR:
+			out<<"\taddq\t"<<b<<", "<<work<<"\t\t# OR"<<endl;
+			break;
+		case OP_SUB:
+			out<<"\tsubq\t"<<b<<", "<<work<<"\t\t# SUB"<<endl;
+			break;
+		case OP_MUL:
+			out<<"\timulq\t"<<b<<", "<<work<<"\t\t# MUL"<<endl;
+			break;
+		case OP_AND:
+			out<<"\timulq\t"<<b<<", "<<work<<"\t\t# AND"<<endl;
+			break;
+		default:
+			break;
+	}
+	Move(out, work, result);
+}
+
+// The flags are turned into 0 or 1 by setcc, then into FALSE (0) or TRUE (0xFFFFFFFFFFFFFFFF) without a branch
+static void EmitComparison(ostream& out, Instruction* instruction) {
+	size_t position=Position.at(instruction);
+	const char* set=NULL;
+	const char* comment=NULL;
+	if (instruction->args[0]->type==DOUBLE) {
+		Move(out, Location(instruction->args[0], position), "%xmm0");
+		out<<"\tucomisd\t"<<Location(instruction->args[1], position)<<", %xmm0"<<endl;
+	}
+	else {
+		string b=Operand(out, instruction->args[1], position, "%rcx");
+		Move(out, Operand(out, instruction->args[0], position, "%rax"), "%rax");
+		out<<"\tcmpq\t"<<b<<", %rax"<<endl;
+	}
+	switch (instruction->op) {
+		case OP_EQU: set="sete "; comment="If equal"; break;
+		case OP_DIFF: set="setne"; comment="If different"; break;
+		case OP_SUPE: set="setae"; comment="If above or equal"; break;
+		case OP_INFE: set="setbe"; comment="If below or equal"; break;
+		case OP_INF: set="setb "; comment="If below"; break;
+		case OP_SUP: set="seta "; comment="If above"; break;
+		default: break;
+	}
+	out<<"\t"<<set<<"\t%al\t\t# "<<comment<<endl;
+	out<<"\tmovzbq\t%al, %rax"<<endl;
+	out<<"\tnegq\t%rax\t\t# 1 becomes TRUE"<<endl;
+	Move(out, "%rax", Location(instruction, position));
+}
+
+// Both values are already computed : cmov picks one without a branch (doubles go through integer registers)
+static void EmitSelect(ostream& out, Instruction* instruction) {
+	size_t position=Position.at(instruction);
+	Move(out, Operand(out, instruction->args[2], position, "%rax"), "%rax");
+	string iftrue=Operand(out, instruction->args[1], position, "%rdx");
+	if (iftrue[0]=='$' || IsVector(iftrue)) {
+		Move(out, iftrue, "%rdx");
+		iftrue="%rdx";
+	}
+	string condition=Operand(out, instruction->args[0], position, "%rcx");
+	if (condition[0]=='$') {
+		Move(out, condition, "%rcx");
+		condition="%rcx";
+	}
+	out<<"\tcmpq\t$0, "<<condition<<endl;
+	out<<"\tcmovneq\t"<<iftrue<<", %rax\t# Value if TRUE"<<endl;
+	Move(out, "%rax", Location(instruction, position));
+}
+
+// Vector registers live across the calls of 'instruction' go to their slot before them, and come back after them
+static void SaveVectors(ostream& out, Instruction* instruction) {
+	PassMap<Instruction*, PassVector<size_t> >::const_iterator saved=Saved.find(instruction);
+	for (size_t s=0; saved!=Saved.end() && s<saved->second.size(); s++) {
+		const Interval& interval=Intervals[saved->second[s]];
+		out<<"\tmovq\t"<<RegisterName(interval)<<", "<<Slot(interval.slot)<<"\t# Not preserved by the call"<<endl;
+	}
+}
+
+static void RestoreVectors(ostream& out, Instruction* instruction) {
+	PassMap<Instruction*, PassVector<size_t> >::const_iterator saved=Saved.find(instruction);
+	for (size_t s=0; saved!=Saved.end() && s<saved->second.size(); s++) {
+		const Interval& interval=Intervals[saved->second[s]];
+		out<<"\tmovq\t"<<Slot(interval.slot)<<", "<<RegisterName(interval)<<endl;
+	}
+}
+
+static void EmitDisplay(ostream& out, Instruction* instruction) {
+	size_t position=Position.at(instruction);
+	SaveVectors(out, instruction);
+	string value=instruction->type==DOUBLE ? Location(instruction->args[0], position) : Operand(out, instruction->args[0], position, "%rsi");
+	switch (instruction->type) {
+		case INTEGER:
+			Move(out, value, "%rsi");
+			out<<"\tmovq\t$FormatString1, %rdi\t\t#%llu"<<endl;
+			out<<"\tmovl\t$0, %eax"<<endl;
+			break;
+		case BOOLEAN:
+			Move(out, value, "%rsi");
+			out<<"\tcmpq\t$0, %rsi"<<endl;
+			out<<"\tje  \tFALSE"<<instruction->id<<endl;
+			out<<"\tmovq\t$TrueString, %rdi\t\t# TRUE"<<endl;
+			out<<"\tjmp \tDISPLAYend"<<instruction->id<<endl;
+			out<<"FALSE"<<instruction->id<<":"<<endl;
+			out<<"\tmovq\t$FalseString, %rdi\t\t# FALSE"<<endl;
+			out<<"DISPLAYend"<<instruction->id<<":"<<endl;
+			out<<"\tmovl\t$0, %eax"<<endl;
+			break;
+		case CHAR:
+			Move(out, value, "%rsi");				// character in the 8 lowest bits of %rsi
+			out<<"\tmovq\t$FormatString3, %rdi\t# \"%c\""<<endl;
+			out<<"\tmovl\t$0, %eax"<<endl;
+			break;
+		case DOUBLE:
+			Move(out, value, "%xmm0");
+			out<<"\tmovq\t$FormatString2, %rdi\t# \"%lf\""<<endl;
+			out<<"\tmovl\t$1, %eax\t\t# one vector register used"<<endl;
+			break;
+		default:
+			break;
+	}
+	out<<"\tcall\tprintf@PLT"<<endl;
+	out<<"\tmovq\t$10, %rdi\t\t# ASCII code for newline character"<<endl;
+	out<<"\tcall\tputchar@PLT"<<endl;
+	RestoreVectors(out, instruction);
+}
+
+// The runtime runs the body on several threads, which read the variables from .data
+static void EmitParallel(ostream& out, Instruction* instruction) {
+	size_t position=Position.at(instruction);
+	SaveVectors(out, instruction);
+	Move(out, Operand(out, instruction->args[1], position, "%rdx"), "%rdx");
+	Move(out, Operand(out, instruction->args[0], position, "%rsi"), "%rsi");
+	out<<"\tmovq\t$"<<instruction->var<<", %rdi\t# Body of the PARALLEL FOR"<<endl;
+	out<<"\tcall\tpascal_parallel_for"<<endl;
+	RestoreVectors(out, instruction);
+}
+
+// A thread combines its part of a REDUCE variable with .data : 'lock add' for the additions (sums and ||),
+// otherwise the new value is computed from the one read, and stored by 'lock cmpxchg' if the variable did not
+// change in the meantime (&& is a multiplication, like in the expressions)
+static void EmitReduce(ostream& out, Instruction* instruction) {
+	size_t position=Position.at(instruction);
+	Instruction* value=instruction->args[0];
+	if (instruction->type!=DOUBLE && (instruction->imm==OP_ADD || instruction->imm==OP_OR)) {
+		Move(out, Operand(out, value, position, "%rdx"), "%rdx");
+		out<<"\tlock addq\t%rdx, "<<instruction->var<<"\t# REDUCE"<<endl;
+		return;
+	}
+	string part=instruction->type==DOUBLE ? Location(value, position) : Operand(out, value, position, "%rdx");
+	out<<"\tmovq\t"<<instruction->var<<", %rax"<<endl;
+	out<<"1:"<<endl;
+	if (instruction->type==DOUBLE) {
+		out<<"\tmovq\t%rax, %xmm0"<<endl;
+		out<<"\t"<<(instruction->imm==OP_ADD ? "addsd" : "mulsd")<<"\t"<<part<<", %xmm0"<<endl;
+		out<<"\tmovq\t%xmm0, %rcx"<<endl;
+	}
+	else {
+		out<<"\tmovq\t%rax, %rcx"<<endl;
+		out<<"\timulq\t"<<part<<", %rcx"<<endl;
+	}
+	out<<"\tlock cmpxchgq\t%rcx, "<<instruction->var<<"\t# REDUCE, unless another thread changed it"<<endl;
+	out<<"\tjne \t1b"<<endl;
+}
+
+// 'next' is the block that follows in the layout : there is no jump to it
+static void EmitInstruction(ostream& out, Instruction* instruction, Block* next) {
+	Block* block=instruction->block;
+	size_t position=Position.at(instruction);
+	string value;
+	switch (instruction->op) {
+		case OP_CONST:								// Integer constants are immediate operands
+			if (instruction->type==DOUBLE) {
+				out<<"\tmovabsq\t$"<<instruction->imm<<", %rax"<<endl;
+				Move(out, "%rax", Location(instruction, position));
+			}
+			break;
+		case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD: case OP_AND: case OP_OR:
+			EmitArithmetic(out, instruction);
+			break;
+		case OP_EQU: case OP_DIFF: case OP_INF: case OP_SUP: case OP_INFE: case OP_SUPE:
+			EmitComparison(out, instruction);
+			break;
+		case OP_SELECT:
+			EmitSelect(out, instruction);
+			break;
+		case OP_LOAD:								// Value stored by main before a PARALLEL FOR
+			if (instruction->type==CHAR) {
+				out<<"\tmovzbq\t"<<instruction->var<<", %rax"<<endl;
+				Move(out, "%rax", Location(instruction, position));
+			}
+			else {
+				Move(out, instruction->var, Location(instruction, position));
+			}
+			break;
+		case OP_ARG:								// Range of iterations of a PARALLEL FOR body
+			Move(out, instruction->imm==0 ? "%rdi" : "%rsi", Location(instruction, position));
+			break;
+		case OP_STORE:								// Final value of a variable
+			value=Operand(out, instruction->args[0], position, "%rax");
+			if (instruction->type==CHAR) {
+				Move(out, value, "%rax");
+				out<<"\tmovb\t%al, "<<instruction->var<<endl;
+			}
+			else {
+				Move(out, value, instruction->var);
+			}
+			break;
+		case OP_DISPLAY:
+			EmitDisplay(out, instruction);
+			break;
+		case OP_PARALLEL:
+			EmitParallel(out, instruction);
+			break;
+		case OP_REDUCE:
+			EmitReduce(out, instruction);
+			break;
+		case OP_JUMP:
+			EmitPhiMoves(out, Index.at(block));
+			if (block->succs[0]!=next) {
+				out<<"\tjmp \t"<<block->succs[0]->label<<endl;
+			}
+			break;
+		case OP_BRANCH:
+			EmitPhiMoves(out, Index.at(block));
+			value=Operand(out, instruction->args[0], position, "%rax");
+			if (value[0]=='$') {
+				Move(out, value, "%rax");
+				value="%rax";
+			}
+			out<<"\tcmpq\t$0, "<<value<<endl;
+			if (block->succs[1]==next) {
+				out<<"\tjne \t"<<block->succs[0]->label<<"\t# Jump if the condition is TRUE"<<endl;
+				break;
+			}
+			out<<"\tje  \t"<<block->succs[1]->label<<"\t# Jump if the condition is FALSE"<<endl;
+			if (block->succs[0]!=next) {
+				out<<"\tjmp \t"<<block->succs[0]->label<<endl;
+			}
+			break;
+		case OP_RET:
+			for (size_t r=0; r<CalleeSaved.size(); r++) {
+				out<<"\tmovq\t"<<Slot(CalleeSaved[r].second)<<", "<<CalleeSaved[r].first<<endl;
+			}
+			if (CurrentFunction==Functions[0]) {
+				out<<"\tmovl\t$0, %eax\t\t# Exit status"<<endl;
+			}
+			out<<"\tmovq\t%rbp, %rsp\t\t# Restore the position of the stack's top"<<endl;
+			out<<"\tpopq\t%rbp"<<endl;
+			out<<"\tret\t\t\t# Return from "<<CurrentFunction->label<<" function"<<endl;
+			break;
+		default:
+			break;
+	}
+}
+
+// Loop tops (targets of a backward branch) start on a 16-byte boundary, so that the instruction fetch of each
+// iteration starts at the beginning of a fetch block. A loop small enough to fit in 32 bytes is aligned on 32 bytes.
+// When the previous block falls into the loop, its padding is executed : it is then limited to 7 bytes.
+static void AlignLoops(void) {
+	PassMap<Block*, size_t> position;
+	PassVector<size_t> size(Blocks.size()+1, 0);	// Estimated size of the blocks before each one
+	Alignment.assign(Blocks.size(), (const char*) NULL);
+	for (size_t b=0; b<Blocks.size(); b++) {
+		position[Blocks[b]]=b;
+		size[b+1]=size[b]+(Blocks[b]->phis.size()+Blocks[b]->code.size())*InstructionBytes;
+	}
+	for (size_t b=1; b<Blocks.size(); b++) {
+		size_t last=0;								// Last block of the layout that branches back to this one
+		for (size_t p=0; p<Blocks[b]->preds.size(); p++) {
+			last=max(last, position[Blocks[b]->preds[p]]);
+		}
+		if (last<b) {
+			continue;
+		}
+		Block* previous=Blocks[b-1];
+		Instruction* terminator=previous->code.back();
+		bool fallthrough=terminator->op!=OP_RET && find(previous->succs.begin(), previous->succs.end(), Blocks[b])!=previous->succs.end();
+		if (fallthrough) {
+			Alignment[b]="\t.p2align 4,,7";
+		}
+		else if (size[last+1]-size[b]<=32) {
+			Alignment[b]="\t.p2align 5";
+		}
+		else {
+			Alignment[b]="\t.p2align 4";
+		}
+	}
+}
+
+// -g : label of a position where a variable changes place
+static void DebugLabel(ostream& out, size_t position) {
+	if (SourceFile!=NULL && DebugLabels.count(position)) {
+		out<<".Lpos"<<FunctionNumber<<"_"<<position<<":"<<endl;
+	}
+}
+
+static void EmitBlock(ostream& out, size_t b, long frame) {
+	Block* block=Blocks[b];
+	Block* next=b+1<Blocks.size() ? Blocks[b+1] : NULL;
+	if (Alignment[b]!=NULL) {
+		out<<Alignment[b]<<"\t\t# Loop"<<endl;
+	}
+	out<<block->label<<":"<<endl;
+	if (block==Blocks[0]) {							// The start of the function
+		out<<"\tpushq\t%rbp"<<endl;
+		out<<"\tmovq\t%rsp, %rbp\t# Save the position of the stack's top"<<endl;
+		out<<"\tsubq\t$"<<frame<<", %rsp\t# Slots of the values"<<endl;
+		for (size_t r=0; r<CalleeSaved.size(); r++) {
+			out<<"\tmovq\t"<<CalleeSaved[r].first<<", "<<Slot(CalleeSaved[r].second)<<"\t# Preserved for the caller"<<endl;
+		}
+	}
+	for (size_t i=0; i<SplitAt[b].size(); i++) {
+		const Interval& interval=Intervals[SplitAt[b][i]];
+		out<<"\tmovq\t"<<RegisterName(interval)<<", "<<Slot(interval.slot)<<"\t# Spilled from here"<<endl;
+	}
+	DebugLabel(out, First[b]);
+	unsigned long line=0;
+	for (size_t i=0; i<block->code.size(); i++) {
+		Instruction* instruction=block->code[i];
+		bool code=instruction->op!=OP_CONST || instruction->type==DOUBLE;
+		if (SourceFile!=NULL && code && instruction->line!=0 && instruction->line!=line) {
+			line=instruction->line;					// Each block starts with its line : it may be entered from another one
+			out<<"\t.loc 1 "<<line<<endl;
+		}
+		DebugLabel(out, Position.at(instruction));
+		EmitInstruction(out, instruction, next);
+	}
+}
+
+// A string of the assembly code : the name of the source program may contain quotes and backslashes
+static string Quoted(const char* text) {
+	string quoted="\"";
+	for (const char* c=text; *c!='\0'; c++) {
+		if (*c=='"' || *c=='\\') {
+			quoted+='\\';
+		}
+		quoted+=*c;
+	}
+	return quoted+"\"";
+}
+
+// Entry of the location list of a variable : DW_OP_regN for a register, DW_OP_breg6 (%rbp) and the offset of a slot
+static void EmitPlace(ostream& out, const VariableRange& range) {
+	static const int Numbers[]={3, 12, 13, 14, 15};	// DWARF numbers of Registers, %xmm0 is 17
+	string bytes;
+	if (range.reg<0) {
+		long offset=range.slot;
+		bool more=true;
+		bytes+=(char) 0x76;
+		while (more) {								// Signed LEB128
+			unsigned char byte=offset&0x7f;
+			offset>>=7;
+			more=!((offset==0 && !(byte&0x40)) || (offset==-1 && (byte&0x40)));
+			bytes+=(char) (more ? byte|0x80 : byte);
+		}
+	}
+	else {
+		int number=range.type==DOUBLE ? 19+range.reg : Numbers[range.reg];
+		if (number<32) {
+			bytes+=(char) (0x50+number);
+		}
+		else {
+			bytes+=(char) 0x90;						// DW_OP_regx
+			bytes+=(char) number;
+		}
+	}
+	out<<"\t.quad\t.Lpos"<<range.function<<"_"<<range.start<<"-.Ltext0"<<endl;
+	out<<"\t.quad\t.Lpos"<<range.function<<"_"<<range.end<<"-.Ltext0"<<endl;
+	out<<"\t.value\t"<<bytes.size()<<endl;
+	for (size_t i=0; i<bytes.size(); i++) {
+		out<<"\t.byte\t"<<(int) (unsigned char) bytes[i];
+		if (i==0) {
+			out<<"\t\t# "<<(range.reg<0 ? Slot(range.slot) : RegisterName(range.type, range.reg));
+		}
+		out<<endl;
+	}
+}
+
+// DWARF description of the program for the debugger and the profiler : a compilation unit containing the functions and
+// the .data variables with their types. The line table (.debug_line) is made by the assembler from the .loc directives.
+// Inside a function, the variables are the values in registers and slots (.debug_loc), which hide the .data ones.
+static void EmitDebugInfo(ostream& out) {
+	static const char* const TypeNames[]={"INTEGER", "BOOLEAN", "DOUBLE", "CHAR"};
+	static const int TypeSizes[]={8, 8, 8, 1};
+	static const int Encodings[]={0x7, 0x2, 0x4, 0x8};	// DW_ATE_unsigned, boolean, float, unsigned_char
+	out<<"\t.section\t.debug_abbrev,\"\",@progbits"<<endl;
+	out<<".Ldebug_abbrev0:"<<endl;
+	out<<"\t.uleb128 0x1\n\t.uleb128 0x11\n\t.byte 0x1\t\t# DW_TAG_compile_unit, with children"<<endl;
+	out<<"\t.uleb128 0x25\n\t.uleb128 0x8\t\t# DW_AT_producer, DW_FORM_string"<<endl;
+	out<<"\t.uleb128 0x13\n\t.uleb128 0xb\t\t# DW_AT_language, DW_FORM_data1"<<endl;
+	out<<"\t.uleb128 0x3\n\t.uleb128 0x8\t\t# DW_AT_name, DW_FORM_string"<<endl;
+	out<<"\t.uleb128 0x11\n\t.uleb128 0x1\t\t# DW_AT_low_pc, DW_FORM_addr"<<endl;
+	out<<"\t.uleb128 0x12\n\t.uleb128 0x7\t\t# DW_AT_high_pc, DW_FORM_data8"<<endl;
+	out<<"\t.uleb128 0x10\n\t.uleb128 0x17\t\t# DW_AT_stmt_list, DW_FORM_sec_offset"<<endl;
+	out<<"\t.byte 0\n\t.byte 0"<<endl;
+	out<<"\t.uleb128 0x2\n\t.uleb128 0x2e\n\t.byte 0x1\t\t# DW_TAG_subprogram, with children"<<endl;
+	out<<"\t.uleb128 0x3\n\t.uleb128 0x8\t\t# DW_AT_name, DW_FORM_string"<<endl;
+	out<<"\t.uleb128 0x3f\n\t.uleb128 0x19\t\t# DW_AT_external, DW_FORM_flag_present"<<endl;
+	out<<"\t.uleb128 0x11\n\t.uleb128 0x1\t\t# DW_AT_low_pc, DW_FORM_addr"<<endl;
+	out<<"\t.uleb128 0x12\n\t.uleb128 0x7\t\t# DW_AT_high_pc, DW_FORM_data8"<<endl;
+	out<<"\t.byte 0\n\t.byte 0"<<endl;
+	out<<"\t.uleb128 0x3\n\t.uleb128 0x24\n\t.byte 0\t\t# DW_TAG_base_type"<<endl;
+	out<<"\t.uleb128 0x3\n\t.uleb128 0x8\t\t# DW_AT_name, DW_FORM_string"<<endl;
+	out<<"\t.uleb128 0xb\n\t.uleb128 0xb\t\t# DW_AT_byte_size, DW_FORM_data1"<<endl;
+	out<<"\t.uleb128 0x3e\n\t.uleb128 0xb\t\t# DW_AT_encoding, DW_FORM_data1"<<endl;
+	out<<"\t.byte 0\n\t.byte 0"<<endl;
+	out<<"\t.uleb128 0x5\n\t.uleb128 0x2e\n\t.byte 0x1\t\t# DW_TAG_subprogram, not external, with children"<<endl;
+	out<<"\t.uleb128 0x3\n\t.uleb128 0x8\t\t# DW_AT_name, DW_FORM_string"<<endl;
+	out<<"\t.uleb128 0x11\n\t.uleb128 0x1\t\t# DW_AT_low_pc, DW_FORM_addr"<<endl;
+	out<<"\t.uleb128 0x12\n\t.uleb128 0x7\t\t# DW_AT_high_pc, DW_FORM_data8"<<endl;
+	out<<"\t.byte 0\n\t.byte 0"<<endl;
+	out<<"\t.uleb128 0x4\n\t.uleb128 0x34\n\t.byte 0\t\t# DW_TAG_variable"<<endl;
+	out<<"\t.uleb128 0x3\n\t.uleb128 0x8\t\t# DW_AT_name, DW_FORM_string"<<endl;
+	out<<"\t.uleb128 0x49\n\t.uleb128 0x13\t\t# DW_AT_type, DW_FORM_ref4"<<endl;
+	out<<"\t.uleb128 0x3f\n\t.uleb128 0x19\t\t# DW_AT_external, DW_FORM_flag_present"<<endl;
+	out<<"\t.uleb128 0x2\n\t.uleb128 0x18\t\t# DW_AT_location, DW_FORM_exprloc"<<endl;
+	out<<"\t.byte 0\n\t.byte 0"<<endl;
+	out<<"\t.uleb128 0x6\n\t.uleb128 0x34\n\t.byte 0\t\t# DW_TAG_variable, in a function"<<endl;
+	out<<"\t.uleb128 0x3\n\t.uleb128 0x8\t\t# DW_AT_name, DW_FORM_string"<<endl;
+	out<<"\t.uleb128 0x49\n\t.uleb128 0x13\t\t# DW_AT_type, DW_FORM_ref4"<<endl;
+	out<<"\t.uleb128 0x2\n\t.uleb128 0x17\t\t# DW_AT_location, DW_FORM_sec_offset"<<endl;
+	out<<"\t.byte 0\n\t.byte 0"<<endl;
+	out<<"\t.byte 0"<<endl;
+
+	out<<"\t.section\t.debug_info,\"\",@progbits"<<endl;
+	out<<".Ldebug_info0:"<<endl;
+	out<<"\t.long\t.Ldebug_info_end-.Ldebug_info_start\t# Length of the compilation unit"<<endl;
+	out<<".Ldebug_info_start:"<<endl;
+	out<<"\t.value\t0x4\t\t# DWARF version 4"<<endl;
+	out<<"\t.long\t.Ldebug_abbrev0"<<endl;
+	out<<"\t.byte\t0x8\t\t# Size of an address"<<endl;
+	out<<"\t.uleb128 0x1\t\t# Compilation unit"<<endl;
+	out<<"\t.string\t\"Pascal-like compiler by Elliot Pozucek\""<<endl;
+	out<<"\t.byte\t0x9\t\t# DW_LANG_Pascal83"<<endl;
+	out<<"\t.string\t"<<Quoted(SourceFile)<<endl;
+	out<<"\t.quad\t.Ltext0"<<endl;
+	out<<"\t.quad\t.Letext0-.Ltext0"<<endl;
+	out<<"\t.long\t.Ldebug_line0"<<endl;
+	for (size_t f=0; f<Functions.size(); f++) {		// main, then the bodies of the PARALLEL FOR loops
+		const char* label=Functions[f]->label;
+		out<<"\t.uleb128 "<<(f==0 ? "0x2" : "0x5")<<"\t\t# "<<label<<endl;
+		out<<"\t.string\t\""<<label<<"\""<<endl;
+		out<<"\t.quad\t"<<label<<endl;
+		out<<"\t.quad\t.Lend"<<label<<"-"<<label<<endl;
+		for (size_t v=0; v<Variables.size(); v++) {	// Without location in the function, it is optimized out
+			out<<"\t.uleb128 0x6\t\t# Variable "<<Variables[v].first<<" of "<<label<<endl;
+			out<<"\t.string\t\""<<Variables[v].first<<"\""<<endl;
+			out<<"\t.long\t.Ltype"<<TypeNames[Variables[v].second]<<"-.Ldebug_info0"<<endl;
+			out<<"\t.long\t.Ldebug_loc"<<f<<"_"<<v<<endl;
+		}
+		out<<"\t.byte\t0\t\t# End of "<<label<<endl;
+	}
+	for (int t=INTEGER; t<=CHAR; t++) {
+		out<<".Ltype"<<TypeNames[t]<<":"<<endl;
+		out<<"\t.uleb128 0x3\t\t# Type "<<TypeNames[t]<<endl;
+		out<<"\t.string\t\""<<TypeNames[t]<<"\""<<endl;
+		out<<"\t.byte\t"<<TypeSizes[t]<<endl;
+		out<<"\t.byte\t"<<Encodings[t]<<endl;
+	}
+	for (size_t v=0; v<Variables.size(); v++) {
+		out<<"\t.uleb128 0x4\t\t# Variable "<<Variables[v].first<<endl;
+		out<<"\t.string\t\""<<Variables[v].first<<"\""<<endl;
+		out<<"\t.long\t.Ltype"<<TypeNames[Variables[v].second]<<"-.Ldebug_info0"<<endl;
+		out<<"\t.uleb128 0x9\n\t.byte\t0x3\t\t# DW_OP_addr"<<endl;
+		out<<"\t.quad\t"<<Variables[v].first<<endl;
+	}
+	out<<"\t.byte\t0\t\t# End of the compilation unit"<<endl;
+	out<<".Ldebug_info_end:"<<endl;
+	out<<"\t.section\t.debug_loc,\"\",@progbits"<<endl;
+	size_t r=0;										// The ranges are sorted by function and variable
+	for (size_t f=0; f<Functions.size(); f++) {
+		for (size_t v=0; v<Variables.size(); v++) {
+			out<<".Ldebug_loc"<<f<<"_"<<v<<":\t\t# "<<Variables[v].first<<" in "<<Functions[f]->label<<endl;
+			for (; r<VariableRanges.size() && VariableRanges[r].function==f && VariableRanges[r].variable==v; r++) {
+				EmitPlace(out, VariableRanges[r]);
+			}
+			out<<"\t.quad\t0\n\t.quad\t0"<<endl;
+		}
+	}
+	out<<"\t.section\t.debug_line,\"\",@progbits"<<endl;
+	out<<".Ldebug_line0:"<<endl;
+}
+
+// The tables of a function are in PassArena : they are emptied before it is reset
+static void ForgetTables(void) {
+	Intervals=PassVector<Interval>();
+	Number=PassMap<Instruction*, size_t>();
+	Position=PassMap<Instruction*, size_t>();
+	Index=PassMap<Block*, size_t>();
+	First=PassVector<size_t>();
+	Last=PassVector<size_t>();
+	Loops=PassVector<LoopRange>();
+	Innermost=PassVector<int>();
+	Depth=PassVector<int>();
+	SplitPoints=PassVector<size_t>();
+	SplitAt=PassVector<PassVector<size_t> >();
+	Saved=PassMap<Instruction*, PassVector<size_t> >();
+	CalleeSaved=PassVector<pair<const char*, long> >();
+	Alignment=PassVector<const char*>();
+	DebugLabels=PassSet<size_t>();
+	ResetArena(PassArena);
+}
+
+// The selected function
+static void EmitFunction(ostream& out) {
+	NumberPositions();
+	BuildIntervals();
+	FindSplitPoints();
+	ScanIntervals();
+	long frame=AllocateSlots();
+	AlignLoops();
+	if (SourceFile!=NULL) {
+		LocateVariables();
+		out<<"\t.type\t"<<CurrentFunction->label<<", @function"<<endl;
+	}
+
+	for (size_t b=0; b<Blocks.size(); b++) {
+		EmitBlock(out, b, frame);
+	}
+	if (SourceFile!=NULL) {
+		out<<".Lend"<<CurrentFunction->label<<":"<<endl;
+		out<<"\t.size\t"<<CurrentFunction->label<<", .-"<<CurrentFunction->label<<endl;
+	}
+	ForgetTables();
+}
+
+void GenerateCode(ostream& out) {
+	out<<"\t\t\t\t# This code was produced by the compiler made by Elliot Pozucek"<<endl;		// Header for the gcc assembler / linker
+	out<<"\t.data"<<endl;
+	out<<"FormatString1:\t.string \"%llu\"\t# used by printf to display 64-bit unsigned integers"<<endl;
+	out<<"FormatString2:\t.string \"%lf\"\t# used by printf to display 64-bit floating point numbers"<<endl;
+	out<<"FormatString3:\t.string \"%c\"\t# used by printf to display a 8-bit single character"<<endl;
+	out<<"TrueString: \t.string \"TRUE\"\t# used by printf to display the boolean value TRUE"<<endl;
+	out<<"FalseString:\t.string \"FALSE\"\t# used by printf to display the boolean value FALSE"<<endl;
+	for (size_t v=0; v<Variables.size(); v++) {
+		switch (Variables[v].second) {				// Aligned : the threads of a PARALLEL FOR update them with lock instructions
+			case INTEGER:
+			case BOOLEAN:
+				out<<"\t.p2align 3"<<endl;
+				out<<Variables[v].first<<":\t.quad 0"<<endl;
+				break;
+			case DOUBLE:
+				out<<"\t.p2align 3"<<endl;
+				out<<Variables[v].first<<":\t.double 0.0"<<endl;
+				break;
+			case CHAR:
+				out<<Variables[v].first<<":\t.byte 0"<<endl;
+				break;
+			default:
+				break;
+		}
+	}
+
+	out<<"\t.text\t\t# The following lines contain the program"<<endl;
+	out<<"\t.globl main\t# The main function must be visible from outside"<<endl;
+	if (SourceFile!=NULL) {							// -g : line of the source program of each instruction
+		out<<"\t.file 1 "<<Quoted(SourceFile)<<endl;
+		out<<".Ltext0:"<<endl;
+	}
+	for (size_t f=0; f<Functions.size(); f++) {	// main, then the bodies of the PARALLEL FOR loops
+		SelectFunction(Functions[f]);
+		FunctionNumber=f;
+		EmitFunction(out);
+	}
+	SelectFunction(Functions[0]);
+	if (SourceFile!=NULL) {
+		out<<".Letext0:"<<endl;
+		EmitDebugInfo(out);
+	}
+}
+
+// Forget the code generation of the previous program, even if it did not end, before the arenas are reset
+void ResetCodegen(void) {
+	ForgetTables();
+	VariableRanges=ArenaVector<VariableRange>();
+}
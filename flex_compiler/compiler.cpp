@@ -21,41 +21,88 @@
 #include <string>
 #include <iostream>
 #include <cstdlib>
-#include <set>
 #include <map>
+#include <vector>
 #include <FlexLexer.h>
 #include "tokeniser.h"
+#include "ir.h"
+#include "server.h"
+#include "arena.h"
 #include <cstring>
+#include <cerrno>
+#include <algorithm>
 
 using namespace std;
 
 enum OPREL {EQU, DIFF, INF, SUP, INFE, SUPE, WTFR};
 enum OPADD {ADD, SUB, OR, WTFA};
 enum OPMUL {MUL, DIV, MOD, AND ,WTFM};
-enum TYPES {INTEGER, BOOLEAN, DOUBLE, CHAR ,WTFT};
 
 TOKEN current;				// Current token
 
 
-FlexLexer* lexer = new yyFlexLexer; // This is the flex tokeniser
+// A flex tokeniser that can read several programs, one after the other (compile server)
+class ReusableLexer : public yyFlexLexer {
+public:
+	void Restart(istream* source) {
+		yyrestart(source);
+		yylineno=1;
+	}
+};
+
+ReusableLexer* lexer = new ReusableLexer; // This is the flex tokeniser
 // tokens can be read using lexer->yylex()
 // lexer->yylex() returns the type of the lexicon entry (see enum TOKEN in tokeniser.h)
 // and lexer->YYText() returns the lexicon entry as a string
 
 	
-map<string, TYPES> DeclaredVariables;
+ArenaMap<const char*, TYPES> DeclaredVariables;	// Symbol table, indexed by interned identifiers
 unsigned long TagNumber=0;
+ArenaVector<Instruction*> ValueStack;	// Values of the expression being parsed (where the generated code used to push them)
+
+struct ParallelLoop {						// The PARALLEL FOR whose body is being parsed
+	const char* counter;					// Loop variable, private to each iteration
+	ArenaMap<const char*, OPCODE> reductions;	// REDUCE variables, with their operation
+	ArenaVector<const char*> assigned;		// Other variables assigned in the body
+	const char* assigning;					// Variable of the assignment being parsed
+	unsigned int reads;						// Times a REDUCE variable is read in its own assignment
+};
+ParallelLoop* Parallel=NULL;				// NULL outside of the bodies of PARALLEL FOR loops
+
+struct CompilationFailed {};	// Thrown by Error(), so the compile server survives erroneous programs
+
+// The identifier just read, interned (compared by pointer)
+const char* Name(void){
+	return Intern(CompilationArena, lexer->YYText());
+}
 
 bool IsDeclared(const char *id){
 	return DeclaredVariables.find(id)!=DeclaredVariables.end();
 }
 
 
-void Error(string s){
+void Error(const char* s){
 	// current = token index
 	cerr << "Line n°"<<lexer->lineno()<<", read : '"<<lexer->YYText()<<"'("<<current<<"), but ";
 	cerr<< s << endl;
-	exit(-1);
+	throw CompilationFailed();
+}
+
+void Push(Instruction* value) {
+	ValueStack.push_back(value);
+}
+
+Instruction* Pop(void) {
+	Instruction* value=ValueStack.back();
+	ValueStack.pop_back();
+	return value;
+}
+
+// Replace the two operands on top of the value stack by the result of 'op'
+void Operation(OPCODE op, TYPES type) {
+	Instruction* operand2=Pop();
+	Instruction* operand1=Pop();
+	Push(Emit(op, type, operand1, operand2));
 }
 
 // check if specified keyword is expected and read keyword
@@ -64,17 +111,19 @@ void CheckReadKeyword(const char *keyword) {
 		Error("keyword expected.");
 	}
 	if (strcmp(lexer->YYText(),keyword)!=0) {
-		string err(keyword);
-		string err_msg = "'"+err+"' keyword expected.";
-		Error(err_msg);
+		char message[64];
+		snprintf(message, sizeof(message), "'%s' keyword expected.", keyword);
+		Error(message);
 	}
 	current=(TOKEN) lexer->yylex();
 }
 
-// Statement := AssignementStatement | IfStatement | WhileStatement | ForStatement | BlockStatement | DisplayStatement | CaseStatement
+// Statement := AssignementStatement | IfStatement | WhileStatement | ForStatement | ParallelForStatement | BlockStatement | DisplayStatement | CaseStatement
 // IfStatement := "IF" Expression "THEN" Statement ["ELSE" Statement]
 // WhileStatement := "WHILE" Expression "DO" Statement
 // ForStatement := "FOR" AssignementStatement ("TO" | "DOWNTO") Expression "DO" Statement
+// ParallelForStatement := "PARALLEL" "FOR" Identifier ":=" Expression ("TO" | "DOWNTO") Expression ["REDUCE" Reduction {"," Reduction}] "DO" Statement
+// Reduction := ("+" | "*" | "||" | "&&") Identifier
 // BlockStatement := "BEGIN" Statement { ";" Statement } "END"
 // DisplayStatement := "DISPLAY" Expression
 // CaseStatement := "CASE" Expression "OF" CaseListElement {";" CaseListElement} ["ELSE" Statement] "END"
@@ -107,12 +156,19 @@ void CheckReadKeyword(const char *keyword) {
 // Identifier := Letter{Letter|Digit}
 enum TYPES Identifier(void){
 	enum TYPES type;
-	if (!IsDeclared(lexer->YYText())){			// Triggers an error if the variable is not declared
-		cerr<<"Error: Variable '"<<lexer->YYText()<<"' not declared."<<endl;
+	const char* name=Name();
+	if (!IsDeclared(name)){						// Triggers an error if the variable is not declared
+		cerr<<"Error: Variable '"<<name<<"' not declared."<<endl;
 		Error(".");
 	}
-	type=DeclaredVariables[lexer->YYText()];	// Get type of the variable
-	cout<<"\tpush\t"<<lexer->YYText()<<endl;
+	type=DeclaredVariables[name];				// Get type of the variable
+	if (Parallel!=NULL && Parallel->reductions.find(name)!=Parallel->reductions.end()) {
+		if (name!=Parallel->assigning) {		// Its value is only known once every iteration is done
+			Error("a REDUCE variable can only be read to update it, as in s := s + expression.");
+		}
+		Parallel->reads++;
+	}
+	Push(ReadVariable(name, type));				// Current value of the variable
 	current=(TOKEN) lexer->yylex();				// Advance to next token
 	return type;
 }
@@ -120,32 +176,41 @@ enum TYPES Identifier(void){
 // Number := {digit}+(\.{digit}+)?
 enum TYPES Number(void) {
 	enum TYPES type;
-	string num = lexer->YYText();
+	const char* num = lexer->YYText();		// Converted in place, without a copy
 	double d;								// 64-bit float
-	unsigned long long *l;					// Pointer to 64-bit unsigned integer
-	if (num.find('.') != string::npos) {	// Token is a DOUBLE
-		d = stod(num);						// Convert string TOKEN to double
-		l = (unsigned long long *) &d;		// Get the address of the double
-        unsigned int high_part = *l;
-        unsigned int low_part = *(((unsigned int *)l) + 1);
-        cout<<"\tsubq\t$8, %rsp\t\t\t# allocate 8 bytes on stack's top" << endl;
-        cout<<"\tmovl\t$"<<high_part<<", (%rsp)\t# 32-bit high part of "<<d<<endl;
-        cout<<"\tmovl\t$"<<low_part<< ", 4(%rsp)\t# 32-bit low part of "<<d<<endl;
+	unsigned long long l;					// 64-bit unsigned integer
+	errno = 0;
+	if (strchr(num, '.') != NULL) {			// Token is a DOUBLE
+		d = strtod(num, NULL);				// Convert string TOKEN to double
+		memcpy(&l, &d, sizeof(l));			// Get the 64-bit pattern of the double
 		type = DOUBLE;
 	} 
 	else {									// Token is an INTEGER
-		cout<<"\tpush\t$"<<stoi(lexer->YYText())<<endl;
+		l = strtoull(num, NULL, 10);
 		type = INTEGER;
 	}
+	if (errno == ERANGE) {
+		Error("number out of range.");
+	}
+	Push(Constant(type, l));
 	current=(TOKEN) lexer->yylex(); 		// Advance to next token
 	return type;
 }
 
 // CharConst := "'" Letter "'"
 enum TYPES CharConst(void){
-	cout<<"\tmovq\t$0, %rax"<<endl;
-	cout<<"\tmovb\t$"<<lexer->YYText()<<",%al"<<endl;
-	cout<<"\tpush\t%rax\t# push a 64-bit version of "<<lexer->YYText()<<endl;
+	const char *text = lexer->YYText();		// 'c' or '\c'
+	unsigned char c = text[1];
+	if (c=='\\') {							// Escaped character
+		switch (text[2]) {
+			case 'n': c = '\n'; break;
+			case 't': c = '\t'; break;
+			case 'r': c = '\r'; break;
+			case '0': c = '\0'; break;
+			default: c = text[2];
+		}
+	}
+	Push(Constant(CHAR, c));				// 64-bit version of the character
 	current=(TOKEN) lexer->yylex();			// Advance to next token
 	return CHAR;
 }
@@ -153,10 +218,10 @@ enum TYPES CharConst(void){
 // BoolConst := "TRUE" | "FALSE"
 enum TYPES BoolConst(void) {
 	if (strcmp(lexer->YYText(),"FALSE")==0) {
-		cout<<"\tpush\t$0"<<endl;
+		Push(Constant(BOOLEAN, 0));
 	}
 	else {
-		cout<<"\tpush\t$0xFFFFFFFFFFFFFFFF"<<endl;
+		Push(Constant(BOOLEAN, 0xFFFFFFFFFFFFFFFF));
 	}
 	current=(TOKEN) lexer->yylex();			// Advance to next token
 	return BOOLEAN;
@@ -237,57 +302,25 @@ enum TYPES Term(void) {
 				if (type2!=BOOLEAN) {					// AND operator can only be applied to booleans
 					Error("TYPES error: cannot apply AND operator to non-boolean types.");
 				}
-				cout<<"\tpop \t%rbx"<<endl;				// Get first operand
-				cout<<"\tpop \t%rax"<<endl;				// Get second operand
-				cout<<"\tmulq\t%rbx"<<endl;				// a * b -> %rdx:%rax
-				cout<<"\tpush\t%rax\t\t# AND"<<endl;	// Store result
+				Operation(OP_AND, BOOLEAN);				// a * b
 				break;
 			case MUL:
 				if (type2!=INTEGER && type2!=DOUBLE) {	// Multiplication can only be applied to integers or doubles
 					Error("TYPES error: cannot apply MUL operator to non-numerical types.");
 				}
-				if (type2==INTEGER) {						// Multiplication of two integers
-					cout<<"\tpop \t%rbx"<<endl;				// Get first operand
-					cout<<"\tpop \t%rax"<<endl;				// Get second operand
-					cout<<"\tmulq\t%rbx"<<endl;				// a * b -> %rdx:%rax
-					cout<<"\tpush\t%rax\t\t# MUL"<<endl;	// Store result
-				}
-				else {										// Multiplication of two doubles
-					cout<<"\tfldl\t(%rsp)"<<endl;			// Store first operand in %st(0)
-					cout<<"\tfldl\t8(%rsp)"<<endl;			// Store second operand in %st(0) (first operand is now in %st(1))
-					cout<<"\tfmulp\t%st(0), %st(1)"<<endl;	// Multiply %st(0) by %st(1) and store result in %st(1), then depile FPU stack (%st(0) now contains the result)
-					cout<<"\taddq\t$8, %rsp"<<endl;			// Depile CPU's stack
-					cout<<"\tfstpl\t(%rsp)"<<endl;			// Depile %st(0) and put it on top of the CPU stack
-				}
+				Operation(OP_MUL, type2);					// Multiplication of two integers or two doubles
 				break;
 			case DIV:
 				if (type2!=INTEGER && type2!=DOUBLE) {		// Division can only be applied to integers or doubles
 					Error("TYPES error: cannot apply DIV operator to non-numerical types.");
 				}
-				if (type2==INTEGER) {						// Division of two integers
-					cout<<"\tpop \t%rbx"<<endl;				// Get first operand
-					cout<<"\tpop \t%rax"<<endl;				// Get second operand
-					cout<<"\tmovq\t$0, %rdx"<<endl; 		// Higher part of numerator set to 0
-					cout<<"\tdiv\t%rbx"<<endl;				// Quotient goes to %rax
-					cout<<"\tpush\t%rax\t\t# DIV"<<endl;	// Store result
-				}
-				else {										// Division if two doubles
-					cout<<"\tfldl\t(%rsp)"<<endl;			// Store first operand in %st(0)
-					cout<<"\tfldl\t8(%rsp)"<<endl;			// Store second operand in %st(0) (first operand is now in %st(1))
-					cout<<"\tfdivp\t%st(0), %st(1)"<<endl;	// Divide %st(0) by %st(1) and store result in %st(1), then depile FPU stack (%st(0) now contains the result)
-					cout<<"\taddq\t$8, %rsp"<<endl;			// Depile CPU's stack
-					cout<<"\tfstpl\t(%rsp)"<<endl;			// Depile %st(0) and put it on top of the CPU stack
-				}
+				Operation(OP_DIV, type2);					// Unsigned quotient of two integers, or division of two doubles
 				break;
 			case MOD:
 				if (type2!=INTEGER) {						// MOD operator can only be applied to integers
 					Error("TYPES error: cannot apply MOD operator to non-integer types.");
 				}
-				cout<<"\tpop \t%rbx"<<endl;					// Get first operand
-				cout<<"\tpop \t%rax"<<endl;					// Get second operand
-				cout<<"\tmovq\t$0, %rdx"<<endl; 			// Higher part of numerator set to 0
-				cout<<"\tdiv\t%rbx"<<endl;					// Remainder goes to %rdx
-				cout<<"\tpush\t%rdx\t\t# MOD"<<endl;		// Store result
+				Operation(OP_MOD, INTEGER);					// Remainder of the unsigned division
 				break;
 			default:
 				Error("multiplicative operator expected.");
@@ -334,46 +367,19 @@ enum TYPES SimpleExpression(void) {
 				if (type2!=BOOLEAN) {							// OR operator can only be applied to booleans
 					Error("TYPES error: cannot apply OR operator to non-boolean types.");
 				}
-				cout<<"\tpop \t%rbx"<<endl;						// Get first operand
-				cout<<"\tpop \t%rax"<<endl;						// Get second operand
-				cout<<"\taddq\t%rbx, %rax\t\t# OR"<<endl;		// Operand1 OR operand2
-				cout<<"\tpush\t%rax"<<endl;						// Store result
+				Operation(OP_OR, BOOLEAN);						// Operand1 OR operand2 (a + b)
 				break;			
 			case ADD:
 				if (type2!=INTEGER && type2!=DOUBLE) {			// Addition can only be applied to integers or doubles
 					Error("TYPES error: cannot add non-numerical types.");
 				}
-				if (type2==INTEGER) {
-					cout<<"\tpop \t%rbx"<<endl;					// Get first operand
-					cout<<"\tpop \t%rax"<<endl;					// Get second operand
-					cout<<"\taddq\t%rbx, %rax\t\t# ADD"<<endl;	// Add both operands
-					cout<<"\tpush\t%rax"<<endl;					// Store result
-				}
-				else {
-					cout<<"\tfldl\t(%rsp)"<<endl;				// Store first operand in %st(0)
-					cout<<"\tfldl\t8(%rsp)"<<endl;				// Store second operand in %st(0) (first operand is now in %st(1))
-					cout<<"\tfaddp\t%st(0), %st(1)"<<endl;		// Add %st(0) to %st(1) and store result in %st(1), then depile FPU stack (%st(0) now contains the result)
-					cout<<"\taddq\t$8, %rsp"<<endl;				// Depile CPU's stack
-					cout<<"\tfstpl\t(%rsp)"<<endl;				// Depile %st(0) and put it on top of the CPU stack
-				}
+				Operation(OP_ADD, type2);						// Add both operands
 				break;			
 			case SUB:
 				if (type2!=INTEGER && type2!=DOUBLE) {			// Substraction can only be applied to integers or doubles
 					Error("TYPES error: cannot substract non-numerical types.");
 				}
-				if (type2==INTEGER) {
-					cout<<"\tpop \t%rbx"<<endl;					// Get first operand
-					cout<<"\tpop \t%rax"<<endl;					// Get second operand
-					cout<<"\tsubq\t%rbx, %rax\t\t# SUB"<<endl;	// Substract both operands
-					cout<<"\tpush\t%rax"<<endl;					// Store result
-				}
-				else {
-					cout<<"\tfldl\t(%rsp)"<<endl;				// Store first operand in %st(0)
-					cout<<"\tfldl\t8(%rsp)"<<endl;				// Store second operand in %st(0) (first operand is now in %st(1))
-					cout<<"\tfsubp\t%st(0), %st(1)"<<endl;		// Substract %st(0) from %st(1) and store result in %st(1), then depile FPU stack (%st(0) now contains the result)
-					cout<<"\taddq\t$8, %rsp"<<endl;				// Depile CPU's stack
-					cout<<"\tfstpl\t(%rsp)"<<endl;				// Depile %st(0) and put it on top of the CPU stack
-				}
+				Operation(OP_SUB, type2);						// Substract both operands
 				break;
 			default:
 				Error("additive operator expected.");
@@ -404,13 +410,24 @@ TYPES Type(void) {
 	return type;
 }
 
+// Insert an interned identifier in alphabetical order, once
+void AddIdentifier(ArenaVector<const char*>& identifiers, const char* name) {
+	size_t i=0;
+	while (i<identifiers.size() && strcmp(identifiers[i], name)<0) {
+		i++;
+	}
+	if (i==identifiers.size() || identifiers[i]!=name) {
+		identifiers.insert(identifiers.begin()+i, name);
+	}
+}
+
 // VarDeclaration := Identifier {"," Identifier} ":" Type
 void VarDeclaration(void) {
-	set<string> identifiers;					// Set to store identifiers
+	ArenaVector<const char*> identifiers;		// Identifiers, sorted and without duplicates
 	if (current!=ID) {
 		Error("identifier expected.");
 	}
-	identifiers.insert(lexer->YYText());		// Store identifier in set
+	AddIdentifier(identifiers, Name());		// Store identifier
 	current=(TOKEN)lexer->yylex();				// Consume identifier and advance to next token
 
 	while(current==COMMA) {						// Loop to get all identifiers
@@ -418,7 +435,7 @@ void VarDeclaration(void) {
 		if (current!=ID) {
 			Error("identifier expected.");
 		}
-		identifiers.insert(lexer->YYText());	// Store identifier in set
+		AddIdentifier(identifiers, Name());	// Store identifier
 		current=(TOKEN)lexer->yylex();			// Consume identifier and advance to next token
 	}
 
@@ -428,22 +445,18 @@ void VarDeclaration(void) {
 	current=(TOKEN)lexer->yylex();				// Consume ':' and advance to next token
 
 	TYPES type = Type();						// Get type of the variable
-	for(set<string>::iterator i=identifiers.begin(); i!=identifiers.end(); ++i) {
-		switch(type) {							// Print variable name and its type
+	for(size_t i=0; i<identifiers.size(); i++) {
+		switch(type) {							// Check the type of the variable
 			case INTEGER:
 			case BOOLEAN:
-				cout<<*i<<":\t.quad 0"<<endl;	
-				break;
 			case DOUBLE:
-				cout<<*i<<":\t.double 0.0"<<endl;
-				break;
 			case CHAR:
-				cout<<*i<<":\t.byte 0"<<endl;
 				break;
 			default:
 				Error("unknown type."); 
 		}
-		DeclaredVariables[*i]=type;				// Add variable to declared variables map
+		DeclaredVariables[identifiers[i]]=type;	// Add variable to declared variables map
+		Variables.push_back(make_pair(identifiers[i], type));	// The code generator allocates it in .data
 	}
 }
 
@@ -494,6 +507,7 @@ OPREL RelationalOperator(void) {
 enum TYPES Expression(void) {
 	TYPES type1, type2;
 	OPREL oprel;
+	SourceLine=lexer->lineno();														// For the debug information
 	type1 = SimpleExpression();														// Get first simple expression and its type
 	if (current==RELOP) {
 		oprel=RelationalOperator(); 												// Save operator in local variable
@@ -501,61 +515,77 @@ enum TYPES Expression(void) {
 		if (type1!=type2) {															// Triggers an error if the types are different
 			Error("TYPES error: cannot compare different types.");
 		}
-		if (type1!=DOUBLE) {
-			cout<<"\tpop \t%rax"<<endl;
-			cout<<"\tpop \t%rbx"<<endl;
-			cout<<"\tcmpq\t%rax, %rbx"<<endl;
-		}
-		else {
-			cout<<"\tfldl\t(%rsp)"<<endl;											// Store first operand in %st(0)
-			cout<<"\tfldl\t8(%rsp)"<<endl;											// Store second operand in %st(0) (first operand is now in %st(1))
-			cout<<"\taddq\t$16, %rsp"<<endl;										// Depile CPU's stack 2 times
-			cout<<"\tfcomi\t%st(1)"<<endl;											// Compare %st(0) to %st(1)
-			cout<<"\tfstp\t%st(0)"<<endl;											// Depile %st(0)
-			cout<<"\tfstp\t%st(0)"<<endl;											// Depile %st(0)
-		}
-		switch(oprel) {
+		switch(oprel) {																// Unsigned comparisons of integers, ordered comparisons of doubles
 			case EQU:
-				cout<<"\tje  \tVrai"<<++TagNumber<<"\t\t# If equal"<<endl;			// Jump if equal
+				Operation(OP_EQU, BOOLEAN);												// If equal
 				break;
 			case DIFF:
-				cout<<"\tjne \tVrai"<<++TagNumber<<"\t\t# If different"<<endl;		// Jump if different
+				Operation(OP_DIFF, BOOLEAN);											// If different
 				break;
 			case SUPE:
-				cout<<"\tjae \tVrai"<<++TagNumber<<"\t\t# If above or equal"<<endl;	// Jump if above or equal
+				Operation(OP_SUPE, BOOLEAN);											// If above or equal
 				break;
 			case INFE:
-				cout<<"\tjbe \tVrai"<<++TagNumber<<"\t\t# If below or equal"<<endl;	// Jump if below or equal
+				Operation(OP_INFE, BOOLEAN);											// If below or equal
 				break;
 			case INF:
-				cout<<"\tjb  \tVrai"<<++TagNumber<<"\t\t# If below"<<endl;			// Jump if below
+				Operation(OP_INF, BOOLEAN);												// If below
 				break;
 			case SUP:
-				cout<<"\tja  \tVrai"<<++TagNumber<<"\t\t# If above"<<endl;			// Jump if above
+				Operation(OP_SUP, BOOLEAN);												// If above
 				break;
 			default:
 				Error("relational operator expected.");
 		}
-		cout<<"\tpush\t$0\t\t# False"<<endl;
-		cout<<"\tjmp \tNext"<<TagNumber<<endl;
-		cout<<"Vrai"<<TagNumber<<":\tpush\t$0xFFFFFFFFFFFFFFFF\t\t# True"<<endl;	
-		cout<<"Next"<<TagNumber<<":"<<endl;
 		return BOOLEAN;																// Return BOOLEAN if the expression is relational
 	}
 	return type1;																	// Return the type of the expression if not
 }
 
+// Times 'previous' is an operand of the tree of 'op' operations computing 'value'
+unsigned int Occurrences(Instruction* value, Instruction* previous, OPCODE op) {
+	if (value==previous) {
+		return 1;
+	}
+	if (value->op!=op) {
+		return 0;
+	}
+	return Occurrences(value->args[0], previous, op)+Occurrences(value->args[1], previous, op);
+}
+
+// A REDUCE variable given a value otherwise than with its operation 'op'
+void ReductionError(const char* variable, OPCODE op) {
+	const char* symbol=op==OP_ADD ? "+" : op==OP_MUL ? "*" : op==OP_OR ? "||" : "&&";
+	cerr<<"Error: REDUCE variable '"<<variable<<"' must be updated with its own operation, as in "
+		<<variable<<" := "<<variable<<" "<<symbol<<" expression."<<endl;
+	Error(".");
+}
+
+// In the body of a PARALLEL FOR, a REDUCE variable is only updated as in s := s op expression, where op is its operation
+void ParallelAssignment(const char* variable, TYPES type, Instruction* value) {
+	ArenaMap<const char*, OPCODE>::iterator reduction=Parallel->reductions.find(variable);
+	if (reduction!=Parallel->reductions.end()) {
+		if (Parallel->reads!=1 || Occurrences(value, ReadVariable(variable, type), reduction->second)!=1) {
+			ReductionError(variable, reduction->second);
+		}
+	}
+	else if (find(Parallel->assigned.begin(), Parallel->assigned.end(), variable)==Parallel->assigned.end()) {
+		Parallel->assigned.push_back(variable);
+	}
+	Parallel->assigning=NULL;
+}
+
 // AssignementStatement := Identifier ":=" Expression
-string AssignementStatement(void) {
+const char* AssignementStatement(void) {
 	enum TYPES type1, type2;
-	string variable;
+	const char* variable;
 	if (current!=ID)						// Triggers an error if token is not an identifier
 		Error("identifier expected.");
-	if (!IsDeclared(lexer->YYText())) {		// Triggers an error if the identifier is not declared
-		cerr << "Error : variable '"<<lexer->YYText()<<"' is not declared."<<endl;
+	variable=Name();
+	if (!IsDeclared(variable)) {			// Triggers an error if the identifier is not declared
+		cerr << "Error : variable '"<<variable<<"' is not declared."<<endl;
 		Error(".");
 	}
-	variable=lexer->YYText();
 	type1 = DeclaredVariables[variable];	// Get type of the variable
 	current=(TOKEN) lexer->yylex();			// Consume identifier and advance to next token
 
@@ -563,11 +593,21 @@ string AssignementStatement(void) {
 		Error("':=' expected.");
 	}
 	current=(TOKEN) lexer->yylex();
+	if (Parallel!=NULL) {
+		if (variable==Parallel->counter) {
+			Error("the variable of a PARALLEL FOR cannot be assigned in its body.");
+		}
+		Parallel->assigning=variable;
+		Parallel->reads=0;
+	}
 	type2 = Expression();
 	if (type1!=type2) {						// Triggers an error if the types are different
 		Error("TYPES error: cannot assign different types.");
 	}
-	cout<<"\tpop \t"<<variable<<endl;
+	if (Parallel!=NULL) {
+		ParallelAssignment(variable, type1, ValueStack.back());
+	}
+	WriteVariable(variable, Pop());
 	return variable;						// Return the variables name
 }
 
@@ -576,171 +616,311 @@ void Statement(void);
 // DisplayStatement := "DISPLAY" Expression
 void DisplayStatement(void) {
 	enum TYPES type;
-	unsigned long localTag=++TagNumber;
 	CheckReadKeyword("DISPLAY");											// Check if keyword is 'DISPLAY'
 	type = Expression();
 
-	cout<<"DISPLAY"<<localTag<<":"<<endl;									// Label for DISPLAY
 	switch(type) {
-		case INTEGER:
-			cout<<"\tpop \t%rsi\t\t# Value to display"<<endl;
-			cout<<"\tmovq\t$FormatString1, %rdi\t\t#%llu"<<endl;			// Get INTEGER format for printf
-			cout<<"\tmovl\t$0, %eax"<<endl;
-			cout<<"\tpush\t%rbp\t\t# Save the value in %rbp (modified by printf)"<<endl;
-			cout<<"\tcall\tprintf@PLT"<<endl;								// Call printf (will display the value)
-			cout<<"\tpop \t%rbp\t\t# Restore %rbp value"<<endl;
-			break;
-		case BOOLEAN:
-			cout<<"\tpop \t%rsi\t\t# Value to display"<<endl;
-			cout<<"\tcmpq\t$0, %rsi"<<endl;									// Compare value to 0
-			cout<<"\tje  \tFALSE"<<localTag<<endl;							// Jump to FALSE if value is 0
-			cout<<"\tmovq\t$TrueString, %rdi\t\t# TRUE"<<endl;				// Get TRUE string for printf
-			cout<<"\tmovl\t$0, %eax"<<endl;
-			cout<<"\tpush\t%rbp\t\t# Save the value in %rbp (modified by printf)"<<endl;
-			cout<<"\tjmp \tDISPLAYend"<<localTag<<endl;
-			cout<<"FALSE"<<localTag<<":"<<endl;								// Label for FALSE
-			cout<<"\tmovq\t$FalseString, %rdi\t\t# FALSE"<<endl;			// Get FALSE string for printf
-			cout<<"\tmovl\t$0, %eax"<<endl;
-			cout<<"\tpush\t%rbp\t\t# Save the value in %rbp (modified by printf)"<<endl;
-			cout<<"DISPLAYend"<<localTag<<":"<<endl;
-			cout<<"\tcall\tprintf@PLT"<<endl;								// Call printf (will display TRUE or FALSE)
-			cout<<"\tpop \t%rbp\t\t# Restore %rbp value"<<endl;
-			break;
-		case CHAR:
-			cout<<"\tpop \t%rsi\t\t\t# get character in the 8 lowest bits of %si"<<endl;
-			cout<<"\tmovq\t$FormatString3, %rdi\t# \"%c\\n\""<<endl;		// Get CHAR format for printf
-			cout<<"\tmovl\t$0, %eax"<<endl;
-			cout<<"\tpush\t%rbp\t\t# Save the value in %rbp (modified by printf)"<<endl;
-			cout<<"\tcall\tprintf@PLT"<<endl;								// Call printf (will display the character)
-			cout<<"\tpop \t%rbp\t\t# Restore %rbp value"<<endl;
-			break;
-		case DOUBLE:														// Code provided by Pierre Jourlin
-			cout<<"\tmovsd\t(%rsp), %xmm0\t\t# &stack top -> %xmm0"<<endl;
-			cout<<"\tsubq\t$16, %rsp\t\t# allocation for 3 additional doubles"<<endl;
-			cout<<"\tmovsd\t%xmm0, 8(%rsp)"<<endl;
-			cout<<"\tmovq\t$FormatString2, %rdi\t# \"%lf\\n\""<<endl;
-			cout<<"\tmovq\t$1, %rax"<<endl;
-			cout<<"\tcall\tprintf"<<endl;
-			cout<<"nop"<<endl;
-			cout<<"\taddq\t$24, %rsp\t\t\t# pop nothing"<<endl;
+		case INTEGER:														// Displayed with printf "%llu"
+		case BOOLEAN:														// Displayed as TRUE or FALSE
+		case CHAR:															// Displayed with printf "%c"
+		case DOUBLE:														// Displayed with printf "%lf"
+			Emit(OP_DISPLAY, type, Pop());									// Display the value, then a newline character
 			break;
 		default:
 			cerr<<"Type: "<<type<<endl;
 			Error("type cannot be displayed.");
 	}
-	cout<<"\tmovq\t$10, %rdi\t\t# ASCII code for newline character"<<endl;	// Get ASCII code for newline character
-    cout<<"\tcall\tputchar@PLT"<<endl;										// Call putchar (will display newline character and effectively skip a line)
 }
 
 // IfStatement := "IF" Expression "THEN" Statement [ "ELSE" Statement ]
 void IfStatement(void) {
 	enum TYPES type;
 	unsigned long localTag=++TagNumber;
+	Block* iftrue=NewBlock("IFtrue", localTag);							// Block for THEN
+	Block* iffalse=NewBlock("IFfalse", localTag);						// Block for ELSE (even if there is no else)
+	Block* ifend=NewBlock("IFend", localTag);							// Block for end of 'IF' statement
 
 	CheckReadKeyword("IF");
-	cout<<"IF"<<localTag<<":"<<endl; 								// Label for IF
 	type = Expression();
 	if (type!=BOOLEAN) {
 		Error("TYPES error: 'IF' expression must be boolean.");		// Triggers an error if the expression is not boolean in 'IF' statement
 	}
-	cout<<"\tpop \t%rax"<<endl;
-	cout<<"\tcmpq\t$0, %rax"<<endl;
-	cout<<"\tje \tIFfalse"<<localTag<<"\t\t# jump to ELSE "<<endl;	// Jump to ELSE if 'IF' expression is false (even if there is no else)
+	Branch(Pop(), iftrue, iffalse);									// Jump to ELSE if 'IF' expression is false (even if there is no else)
+	SealBlock(iftrue);
+	SealBlock(iffalse);
 
 	CheckReadKeyword("THEN");
-	cout<<"IFtrue"<<localTag<<":\t\t\t# THEN"<<endl; 				// Label for THEN
+	StartBlock(iftrue);
 	Statement();
-	cout<<"\tjmp \tIFend"<<localTag<<"\t\t# jump to endIf"<<endl;	// Jump to end of 'IF' statement
-	cout<<"IFfalse"<<localTag<<":\t\t\t# ELSE"<<endl; 				// Label for ELSE (even if there is no else)
+	Jump(ifend);													// Jump to end of 'IF' statement
 
+	StartBlock(iffalse);
 	if (current==KEYWORD && strcmp(lexer->YYText(),"ELSE")==0) {
 		CheckReadKeyword("ELSE");
 		Statement();
 	}
-	cout<<"IFend"<<localTag<<":"<<endl; 							// Label for end of 'IF' statement
+	Jump(ifend);
+	StartBlock(ifend);
+	SealBlock(ifend);
 }
 
 // WhileStatement := "WHILE" Expression "DO" Statement
 void WhileStatement(void) {
 	unsigned long localTag=++TagNumber;
+	Block* loop=NewBlock("WHILE", localTag);									// Block for the condition
+	Block* body=NewBlock("WHILEtrue", localTag);								// Block for DO
+	Block* end=NewBlock("WHILEend", localTag);									// Block for end of 'WHILE' statement
 
 	CheckReadKeyword("WHILE");
-	cout<<"WHILE"<<localTag<<":"<<endl; 									// Label for WHILE
+	Jump(loop);
+	StartBlock(loop);															// Not sealed until the end of the body jumps back to it
 	Expression();
-	cout<<"\tpop \t%rax"<<endl;
-	cout<<"\tcmpq\t$0, %rax"<<endl;
-	cout<<"\tje \tWHILEend"<<localTag<<"\t\t# jump to end of WHILE"<<endl;	// Jump to end of 'WHILE' statement if expression is false
+	Branch(Pop(), body, end);													// Jump to end of 'WHILE' statement if expression is false
+	SealBlock(body);
+	SealBlock(end);
 
 	CheckReadKeyword("DO");
-	cout<<"WHILEtrue"<<localTag<<":\t\t\t# DO"<<endl; 						// Label for DO
+	StartBlock(body);
 	Statement();
-	cout<<"\tjmp \tWHILE"<<localTag<<endl;									// Jump to 'WHILE' statement
-	cout<<"WHILEend"<<localTag<<":"<<endl; 									// Label for end of 'WHILE' statement
-
+	Jump(loop);																	// Jump to 'WHILE' statement
+	SealBlock(loop);
+	StartBlock(end);
 }
 
-// ForStatement := "FOR" AssignementStatement "TO" Expression "DO" Statement
+// ForStatement := "FOR" AssignementStatement ("TO" | "DOWNTO") Expression "DO" Statement
 void ForStatement(void) {
 	unsigned long localTag=++TagNumber;
 	enum TYPES type;
+	bool to;
+	Instruction* end;
 	CheckReadKeyword("FOR");
-	cout<<"FOR"<<localTag<<":"<<endl; 											// Label for FOR
 
-	string loop_var = AssignementStatement();									// Get loop variable
+	const char* loop_var = AssignementStatement();									// Get loop variable
 	if (DeclaredVariables[loop_var]!=INTEGER) {
 		Error("TYPES error: loop variable must be integer.");					// Triggers an error if the loop variable is not integer
 	}
-	if(strcmp(lexer->YYText(),"TO")==0) {										// If keyword is 'TO'
+	if (Parallel!=NULL && Parallel->reductions.find(loop_var)!=Parallel->reductions.end()) {
+		ReductionError(loop_var, Parallel->reductions[loop_var]);				// Incremented and given the end value, like an assignment
+	}
+	to = strcmp(lexer->YYText(),"TO")==0;
+	if(to) {																	// If keyword is 'TO'
 		CheckReadKeyword("TO");	
 		type=Expression();
-		cout<<"\tpop \t%rdx\t\t# end value"<<endl; 								// Get expression and store it in %rdx				
 		if(type!=INTEGER) {
 			Error("TYPES error: 'TO' expression must be integer.");				// Triggers an error if the expression is not integer in 'TO' statement
 		}
-		cout<<"\tpush\t"<<loop_var<<"\t\t# save loop var on the stack"<<endl;
-		cout<<"\tpush\t%rdx\t\t# save end value on the stack"<<endl;
-
-		cout<<"TO"<<localTag<<":"<<endl; 										// Label for TO
-		cout<<"\tcmpq\t%rdx, "<<loop_var<<endl;
-		cout<<"\tjae \tFORend"<<localTag<<"\t\t# jump at the end of FOR"<<endl; // Jump at the end of 'FOR' statement if loop_var is above or equal expression
-
-		CheckReadKeyword("DO");
-		cout<<"DO"<<localTag<<":"<<endl; 										// Label for DO
-		Statement();
-		cout<<"\tincq\t"<<loop_var<<"\t\t# loop_var++"<<endl;
-		cout<<"\tjmp \tTO"<<localTag<<endl;										// Jump to 'TO' statement
 	}
 	else {																		// If keyword is 'DOWNTO'
 		CheckReadKeyword("DOWNTO");
 		type=Expression();
-		cout<<"\tpop \t%rdx\t\t# end value"<<endl; 								// Get expression and store it in %r12						
 		if(type!=INTEGER) {
 			Error("TYPES error: 'DOWNTO' expression must be integer.");			// Triggers an error if the expression is not integer in 'DOWNTO' statement
 		}
-		cout<<"\tpush\t"<<loop_var<<"\t\t# save loop var on the stack"<<endl;
-		cout<<"\tpush\t%rdx\t\t# save end value on the stack"<<endl;
+	}
+	end=Pop();																	// End value, computed once
+
+	Block* test=NewBlock(to ? "TO" : "DOWNTO", localTag);						// Block for the comparison with the end value
+	Block* body=NewBlock("DO", localTag);										// Block for DO
+	Block* forend=NewBlock("FORend", localTag);									// Block for end of 'FOR' statement
+	Jump(test);
+	StartBlock(test);															// Not sealed until the end of the body jumps back to it
+	Instruction* counter=ReadVariable(loop_var, INTEGER);
+	Branch(Emit(to ? OP_INF : OP_SUP, BOOLEAN, counter, end), body, forend);	// Jump at the end of 'FOR' statement once loop_var reaches the end value
+	SealBlock(body);
+	SealBlock(forend);
 
-		cout<<"DOWNTO"<<localTag<<":"<<endl; 									// Label for DOWNTO
-		cout<<"\tcmpq\t%rdx, "<<loop_var<<endl;
-		cout<<"\tjbe \tFORend"<<localTag<<"\t\t# jump at the end of FOR"<<endl; // Jump at the end of 'FOR' statement if loop_var is below or equal expression
+	CheckReadKeyword("DO");
+	StartBlock(body);
+	Statement();
+	counter=ReadVariable(loop_var, INTEGER);
+	WriteVariable(loop_var, Emit(to ? OP_ADD : OP_SUB, INTEGER, counter, Constant(INTEGER, 1)));	// loop_var++ or loop_var--
+	Jump(test);
+	SealBlock(test);
 
-		CheckReadKeyword("DO");
-		cout<<"DO"<<localTag<<":"<<endl; 								// Label for DO
-		Statement();
-		cout<<"\tdecq\t"<<loop_var<<"\t\t# loop_var--"<<endl;
-		cout<<"\tjmp \tDOWNTO"<<localTag<<endl;								// Jump to 'DOWNTO' statement
+	StartBlock(forend);
+	WriteVariable(loop_var, end);												// The loop var ends up holding the end value
+}
+
+// Reduction := ("+" | "*" | "||" | "&&") Identifier
+void Reduction(ParallelLoop& loop) {
+	OPCODE op;
+	const char* text=lexer->YYText();
+	if (current==ADDOP && strcmp(text, "+")==0) {
+		op=OP_ADD;
+	}
+	else if (current==ADDOP && strcmp(text, "||")==0) {
+		op=OP_OR;
+	}
+	else if (current==MULOP && strcmp(text, "*")==0) {
+		op=OP_MUL;
+	}
+	else if (current==MULOP && strcmp(text, "&&")==0) {
+		op=OP_AND;
+	}
+	else {
+		Error("'+', '*', '||' or '&&' expected after REDUCE.");
+	}
+	current=(TOKEN) lexer->yylex();										// Consume the operator and advance to next token
+	if (current!=ID) {
+		Error("identifier expected.");
+	}
+	const char* variable=Name();
+	if (!IsDeclared(variable)) {
+		cerr<<"Error: Variable '"<<variable<<"' not declared."<<endl;
+		Error(".");
+	}
+	TYPES type=DeclaredVariables[variable];
+	if ((op==OP_ADD || op==OP_MUL) && type!=INTEGER && type!=DOUBLE) {
+		Error("TYPES error: '+' and '*' reductions need an INTEGER or DOUBLE variable.");
+	}
+	if ((op==OP_OR || op==OP_AND) && type!=BOOLEAN) {
+		Error("TYPES error: '||' and '&&' reductions need a BOOLEAN variable.");
 	}
-	cout<<"FORend"<<localTag<<":"<<endl; 									// Label for end of 'FOR' statement
-	cout<<"\tpop \t"<<loop_var<<"\t\t# restore loop var"<<endl;
-	cout<<"\tpop \t%rdx\t\t# restore end value"<<endl;
+	if (variable==loop.counter || loop.reductions.find(variable)!=loop.reductions.end()) {
+		Error("the variable of a PARALLEL FOR and each REDUCE variable can only appear once.");
+	}
+	loop.reductions[variable]=op;
+	current=(TOKEN) lexer->yylex();										// Consume identifier and advance to next token
+}
+
+// Value of a REDUCE variable that does not change the result of its operation
+Instruction* Identity(OPCODE op, TYPES type) {
+	switch (op) {
+		case OP_MUL:
+			return Constant(type, type==DOUBLE ? 0x3FF0000000000000ULL : 1);	// 1 or 1.0
+		case OP_AND:
+			return Constant(type, 0xFFFFFFFFFFFFFFFFULL);						// TRUE
+		default:
+			return Constant(type, 0);											// 0, 0.0 or FALSE
+	}
+}
+
+/* ParallelForStatement := "PARALLEL" "FOR" Identifier ":=" Expression ("TO" | "DOWNTO") Expression ["REDUCE" Reduction {"," Reduction}] "DO" Statement
+The body becomes a function that runs a range of iterations : the runtime (parallel.c) calls it on several threads.
+It reads the variables from .data, main stores them before the loop. Each iteration has its own copy of the
+variables it assigns, which keep their value after the loop, and a REDUCE variable accumulates the values of
+the iterations of a thread from the identity of its operation, then the thread combines them atomically with
+the variable in .data. A variable assigned in the body that an iteration reads before assigning it would hold
+the value of another iteration : it is an error.
+*/
+void ParallelForStatement(void) {
+	unsigned long localTag=++TagNumber, line=lexer->lineno();
+	ParallelLoop loop;
+	Instruction *start, *end, *first, *last;
+	bool to;
+	if (Parallel!=NULL) {
+		Error("a PARALLEL FOR cannot be nested in another one.");
+	}
+	CheckReadKeyword("PARALLEL");
+	CheckReadKeyword("FOR");
+	if (current!=ID) {
+		Error("identifier expected.");
+	}
+	loop.counter=Name();
+	if (!IsDeclared(loop.counter)) {
+		cerr<<"Error: Variable '"<<loop.counter<<"' not declared."<<endl;
+		Error(".");
+	}
+	if (DeclaredVariables[loop.counter]!=INTEGER) {
+		Error("TYPES error: loop variable must be integer.");
+	}
+	current=(TOKEN) lexer->yylex();												// Consume identifier and advance to next token
+	if (current!=ASSIGN) {
+		Error("':=' expected.");
+	}
+	current=(TOKEN) lexer->yylex();
+	if (Expression()!=INTEGER) {
+		Error("TYPES error: loop variable must be integer.");
+	}
+	start=Pop();
+	to=current==KEYWORD && strcmp(lexer->YYText(),"TO")==0;
+	CheckReadKeyword(to ? "TO" : "DOWNTO");
+	if (Expression()!=INTEGER) {
+		Error(to ? "TYPES error: 'TO' expression must be integer." : "TYPES error: 'DOWNTO' expression must be integer.");
+	}
+	end=Pop();
+	if (current==KEYWORD && strcmp(lexer->YYText(),"REDUCE")==0) {
+		CheckReadKeyword("REDUCE");
+		Reduction(loop);
+		while (current==COMMA) {
+			current=(TOKEN) lexer->yylex();										// Consume ',' and advance to next token
+			Reduction(loop);
+		}
+	}
+	CheckReadKeyword("DO");
+	if (to) {																	// Iterations start to end-1, like FOR
+		first=start;
+		last=end;
+	}
+	else {																		// Iterations end+1 to start, in any order
+		first=Emit(OP_ADD, INTEGER, end, Constant(INTEGER, 1));
+		last=Emit(OP_ADD, INTEGER, start, Constant(INTEGER, 1));
+	}
+	StoreVariables();															// The body reads them from .data
+	Block* caller=CurrentBlock;
+	Function* function=CurrentFunction;
+
+	Block* entry=NewBlock("PARALLEL", localTag);								// Also the name of the function
+	SelectFunction(NewFunction(entry->label));
+	StartBlock(entry);
+	SealBlock(entry);
+	Instruction* from=Emit(OP_ARG, INTEGER);
+	Instruction* limit=Emit(OP_ARG, INTEGER);
+	limit->imm=1;
+	WriteVariable(loop.counter, from);
+	for (ArenaMap<const char*, OPCODE>::iterator r=loop.reductions.begin(); r!=loop.reductions.end(); ++r) {
+		WriteVariable(r->first, Identity(r->second, DeclaredVariables[r->first]));
+	}
+	Block* test=NewBlock("PARALLELTO", localTag);								// Block for the comparison with the end of the range
+	Block* body=NewBlock("PARALLELDO", localTag);								// Block for DO
+	Block* done=NewBlock("PARALLELend", localTag);								// Block combining the REDUCE variables
+	Jump(test);
+	StartBlock(test);															// Not sealed until the end of the body jumps back to it
+	Branch(Emit(OP_INF, BOOLEAN, ReadVariable(loop.counter, INTEGER), limit), body, done);
+	SealBlock(body);
+	SealBlock(done);
+	StartBlock(body);
+	Parallel=&loop;
+	Statement();
+	Parallel=NULL;
+	WriteVariable(loop.counter, Emit(OP_ADD, INTEGER, ReadVariable(loop.counter, INTEGER), Constant(INTEGER, 1)));
+	Jump(test);
+	SealBlock(test);
+	StartBlock(done);
+	for (ArenaMap<const char*, OPCODE>::iterator r=loop.reductions.begin(); r!=loop.reductions.end(); ++r) {
+		Instruction* reduce=Emit(OP_REDUCE, DeclaredVariables[r->first], ReadVariable(r->first, DeclaredVariables[r->first]));
+		reduce->var=r->first;
+		reduce->imm=r->second;
+	}
+	Emit(OP_RET, WTFT);
+	for (size_t i=0; i<entry->code.size(); i++) {								// Values read from .data before any assignment
+		Instruction* load=entry->code[i];
+		if (load->op==OP_LOAD && find(loop.assigned.begin(), loop.assigned.end(), load->var)!=loop.assigned.end()) {
+			cerr<<"Error: variable '"<<load->var<<"' is read by an iteration of the PARALLEL FOR before it assigns it : "
+				<<"its value would come from another iteration. Assign it before reading it, or use REDUCE."<<endl;
+			Error(".");
+		}
+	}
+	for (size_t v=0; v<loop.assigned.size(); v++) {
+		cerr<<"Warning: each iteration of the PARALLEL FOR of line "<<line<<" has its own copy of '"
+			<<loop.assigned[v]<<"', which keeps its value after the loop."<<endl;
+	}
+
+	SelectFunction(function);
+	CurrentBlock=caller;
+	Instruction* run=Emit(OP_PARALLEL, WTFT, first, last);
+	run->var=entry->label;
+	for (ArenaMap<const char*, OPCODE>::iterator r=loop.reductions.begin(); r!=loop.reductions.end(); ++r) {
+		Instruction* result=Emit(OP_LOAD, DeclaredVariables[r->first]);		// Combined by the threads
+		result->var=r->first;
+		WriteVariable(r->first, result);
+	}
+	WriteVariable(loop.counter, end);											// The loop var ends up holding the end value
 }
 
 // BlockStatement := "BEGIN" Statement { ";" Statement } "END"
 void BlockStatement(void) {
-	unsigned long localTag=++TagNumber;
-
 	CheckReadKeyword("BEGIN");
-	cout<<"BEGIN"<<localTag<<":"<<endl; 									// Label for BEGIN
 	Statement();
 	while(current==SEMICOLON) {
 		current=(TOKEN) lexer->yylex();
@@ -748,45 +928,39 @@ void BlockStatement(void) {
 	}
 
 	CheckReadKeyword("END");
-	cout<<"END"<<localTag<<":"<<endl; 										// Label for END
 }
 
 // CaseLabel := Factor { "," Factor }
-enum TYPES CaseLabel(unsigned long localTag, unsigned long caseTag, enum TYPES typeExpression) {
+enum TYPES CaseLabel(unsigned long localTag, unsigned long caseTag, enum TYPES typeExpression, Instruction* value, Block* statement, Block* next) {
 	enum TYPES type;
+	unsigned long labelTag = 0;
+	Instruction* equal;
 	do {
 		type = Factor();									// Get factor and its type
 		if (type!=typeExpression) {							// Triggers an error if the types are different
 			Error("TYPES error: cannot compare different types.");
 		}
 		switch (type) {
-			/* With the way DOUBLE are handled (a DOUBLE is interpreted as a 64 bit value, 
-			32bit before the dot, 32 after), it is possible to compare DOUBLE like they were INTEGER)
-			However, it is only possible because we test strict equality, and not a range of values.
+			/* A DOUBLE is compared like the other types, on equality only.
+			CHAR values are zero-extended to 64 bits, so comparing them on 64 bits compares the characters.
 			*/
 			case INTEGER:
 			case BOOLEAN:
 			case DOUBLE:
-				cout<<"\tpop \t%rbx"<<endl;
-				cout<<"\tpop \t%rax"<<endl;
-				cout<<"\tcmpq\t%rax, %rbx"<<endl;
-				cout<<"\tje  \tCaseStatement"<<"_"<<caseTag<<"_"<<localTag<<endl;
-				cout<<"\tpush\t%rax\t\t # push 'CASE' Expression on the stack"<<endl;
-				break;
 			case CHAR:
-				cout<<"\tpop \t%rbx"<<endl;
-				cout<<"\tpop \t%rax"<<endl;
-				cout<<"\tcmpb\t%al, %bl"<<endl;				// Compare 8 bits of %rax and %rbx
-				cout<<"\tje  \tCaseStatement"<<"_"<<caseTag<<"_"<<localTag<<endl;
-				cout<<"\tpush\t%rax\t\t # push 'CASE' Expression on the stack"<<endl;
+				equal=Emit(OP_EQU, BOOLEAN, value, Pop());	// Compare the factor to 'CASE' Expression
 				break;
 			default:
 				Error("unknown type in CaseLabel.");
 		}
 		if (current!=COMMA) {
-			cout<<"\tjmp \tCaseElement"<<"_"<<caseTag+1<<"_"<<localTag<<endl;
+			Branch(equal, statement, next);					// Try the next "CASE" element if it does not match
 			break;
 		}
+		Block* label=NewBlock(Format(CompilationArena, "CaseLabel_%lu_%lu_", caseTag, ++labelTag), localTag);
+		Branch(equal, statement, label);					// Try the next factor if it does not match
+		SealBlock(label);
+		StartBlock(label);
 		current=(TOKEN) lexer->yylex();						// Consume ',' and advance to next token
 	}
 	while (true);
@@ -794,9 +968,10 @@ enum TYPES CaseLabel(unsigned long localTag, unsigned long caseTag, enum TYPES t
 }
 
 // CaseListElement := CaseLabel ":" Statement
-enum TYPES CaseListElement(unsigned long localTag, unsigned long caseTag, enum TYPES typeExpression) {
+enum TYPES CaseListElement(unsigned long localTag, unsigned long caseTag, enum TYPES typeExpression, Instruction* value, Block* next, Block* endcase) {
 	enum TYPES type;
-	type = CaseLabel(localTag, caseTag, typeExpression);
+	Block* statement=NewBlock(Format(CompilationArena, "CaseStatement_%lu_", caseTag), localTag);	// Block for CASE statement
+	type = CaseLabel(localTag, caseTag, typeExpression, value, statement, next);
 	if (type!=typeExpression) {
 		Error("TYPES error: 'CASE' expression and 'CASE' element must have the same type.");
 	}
@@ -804,9 +979,10 @@ enum TYPES CaseListElement(unsigned long localTag, unsigned long caseTag, enum T
 		Error("':' expected.");
 	}
 	current=(TOKEN) lexer->yylex();										// Consume ':' and advance to next token
-	cout<<"CaseStatement_"<<caseTag<<"_"<<localTag<<":"<<endl;			// Label for CASE statement
+	SealBlock(statement);
+	StartBlock(statement);
 	Statement();
-	cout<<"\tjmp \tENDCase"<<localTag<<endl;							// Jump to END of "CASE" statement
+	Jump(endcase);														// Jump to END of "CASE" statement
 	return type;
 }
 
@@ -814,26 +990,34 @@ enum TYPES CaseListElement(unsigned long localTag, unsigned long caseTag, enum T
 void CaseStatement(void) {
 	unsigned long localTag=++TagNumber, caseTag = 0;
 	enum TYPES type1, type2;
+	Instruction* value;
+	Block* element;
+	Block* endcase=NewBlock("ENDCase", localTag);							// Block for END
 	CheckReadKeyword("CASE");												// Read keyword 'CASE'
-	cout<<"CASE"<<localTag<<":"<<endl; 										// Label for CASE
 
 	type1 = Expression();
 	if (type1!=INTEGER && type1!=CHAR && type1!=DOUBLE && type1!=BOOLEAN) {
 		Error("TYPES error: 'CASE' expression must be INTEGER or DOUBLE or CHAR.");
 	}
+	value = Pop();
 
 	CheckReadKeyword("OF");													// Read keyword 'OF'
 
+	element=NewBlock(Format(CompilationArena, "CaseElement_%lu_", ++caseTag), localTag);	// Block for "CASE" element
+	Jump(element);
+	SealBlock(element);
 	do {
-		cout<<"CaseElement_"<<++caseTag<<"_"<<localTag<<":"<<endl;			// Label for "CASE" element
-		type2 = CaseListElement(localTag, caseTag, type1);
+		StartBlock(element);
+		element=NewBlock(Format(CompilationArena, "CaseElement_%lu_", caseTag+1), localTag);	// Next "CASE" element, reached when no label matches
+		type2 = CaseListElement(localTag, caseTag, type1, value, element, endcase);
 		if (type1!=type2) {													// Should not happen (error is triggered in CaseLabel and CaseListElement)
 			Error("TYPES error: 'CASE' expression and 'CASE' element must have the same type.");
 		}
+		SealBlock(element);
 		if (current!=SEMICOLON) {
-			cout<<"CaseElement_"<<caseTag+1<<"_"<<localTag<<":"<<endl;		// Last "CASE" element
 			break;
 		}
+		caseTag++;
 		current=(TOKEN) lexer->yylex();										// Consume ';' and advance to next token
 	}
 	while (true);
@@ -842,20 +1026,21 @@ void CaseStatement(void) {
 		Error("keyword expected (ELSE or END).");
 	}
 
+	StartBlock(element);													// Last "CASE" element
 	if (strcmp(lexer->YYText(),"ELSE")==0) {
 		CheckReadKeyword("ELSE");											// Read keyword 'ELSE'
-		cout<<"ELSECase"<<localTag<<":"<<endl; 								// Label for ELSE
-		cout<<"\tpop \t%rax"<<endl;											// 'CASE' Expression value is not useful anymore, so we pop it
-		cout<<"\txor \t%rax, %rax\t\t# rax = 0"<<endl;						// Set rax to 0
 		Statement();
 	}
+	Jump(endcase);
 
 	CheckReadKeyword("END");												// Read keyword 'END'
-	cout<<"ENDCase"<<localTag<<":"<<endl; 									// Label for END
+	StartBlock(endcase);
+	SealBlock(endcase);
 }
 
-// Statement := AssignementStatement | IfStatement | WhileStatement | ForStatement | BlockStatement | DisplayStatement | CaseStatement
+// Statement := AssignementStatement | IfStatement | WhileStatement | ForStatement | ParallelForStatement | BlockStatement | DisplayStatement | CaseStatement
 void Statement(void) {
+	SourceLine=lexer->lineno();										// For the debug information
 	if (current==ID) {
 		AssignementStatement();
 	}
@@ -872,6 +1057,9 @@ void Statement(void) {
 		else if (strcmp(lexer->YYText(),"FOR")==0) {				// Check if keyword is 'FOR'
 			ForStatement();
 		}
+		else if (strcmp(lexer->YYText(),"PARALLEL")==0) {			// Check if keyword is 'PARALLEL'
+			ParallelForStatement();
+		}
 		else if (strcmp(lexer->YYText(),"BEGIN")==0) {				// Check if keyword is 'BEGIN'
 			BlockStatement();
 		}
@@ -879,7 +1067,7 @@ void Statement(void) {
 			CaseStatement();
 		}
 		else {
-			Error("keyword not identified (must be IF or WHILE or FOR or BEGIN or DISPLAY.)");
+			Error("keyword not identified (must be IF or WHILE or FOR or PARALLEL or BEGIN or DISPLAY.)");
 		}
 	}
 	else {
@@ -890,10 +1078,10 @@ void Statement(void) {
 
 // StatementPart := Statement {";" Statement} "."
 void StatementPart(void) {
-	cout<<"\t.text\t\t# The following lines contain the program"<<endl;
-	cout<<"\t.globl main\t# The main function must be visible from outside"<<endl;
-	cout<<"main:\t\t\t# The main function body :"<<endl;
-	cout<<"\tmovq\t%rsp, %rbp\t# Save the position of the stack's top"<<endl;
+	SelectFunction(NewFunction("main"));
+	Block* entry=NewBlock("main");													// The main function body
+	StartBlock(entry);
+	SealBlock(entry);
 	Statement();
 	while(current==SEMICOLON) {
 		current=(TOKEN) lexer->yylex();												// Consume ';' and advance to next token
@@ -903,37 +1091,110 @@ void StatementPart(void) {
 		Error("caractère '.' attendu");
 	}
 	current=(TOKEN) lexer->yylex();													// Consume '.' and advance to next token
+	Return();																		// Return from main function
 }
 
 // Program := [DeclarationPart] StatementPart
 void Program(void){	
-	cout<<"\t.data"<<endl;
-    // cout<<"\t.align 8" << endl;
-	cout<<"FormatString1:\t.string \"%llu\"\t# used by printf to display 64-bit unsigned integers"<<endl; 
-	cout<<"FormatString2:\t.string \"%lf\"\t# used by printf to display 64-bit floating point numbers"<<endl; 
-	cout<<"FormatString3:\t.string \"%c\"\t# used by printf to display a 8-bit single character"<<endl; 
-	cout<<"TrueString: \t.string \"TRUE\"\t# used by printf to display the boolean value TRUE"<<endl; 
-	cout<<"FalseString:\t.string \"FALSE\"\t# used by printf to display the boolean value FALSE"<<endl;
 	VarDeclarationPart();
 	StatementPart();	
 }
 
-int main(void){
-	cout<<"\t\t\t\t# This code was produced by the compiler made by Elliot Pozucek"<<endl; 		// Header for the gcc assembler / linker
-	current=(TOKEN) lexer->yylex();																// Get first token
-	Program();
-	
-	cout<<"\n\tmovq\t%rbp, %rsp\t\t# Restore the position of the stack's top"<<endl;			// Trailer for the gcc assembler / linker
-	cout<<"\tret\t\t\t# Return from main function"<<endl;
-	if (current!=FEOF) {
-		cerr<<"Unexpected characters at the end of the program: [" << current << "]";			// Unexpected characters at the end of the program
-		Error("."); 
+// Compile the program read by the lexer, returns the exit status of the compiler
+int Compile(int argc, char** argv){
+	bool optimize=true;																			// -O0 : keep the IR as the parser built it
+	bool dumpIR=false;																			// --dump-ir : print the IR instead of the assembly code
+	bool interpret=false;																		// --interpret : run the program instead of printing the assembly code
+	bool emitC=false;																			// --emit=c : print C code instead of the assembly code
+	bool stats=false;																			// --stats : report the memory allocations on stderr
+	unsigned long heap, arena;
+	SourceFile=NULL;																			// -g program.p : debug information for this file
+	Parallel=NULL;																				// Left behind by an erroneous program
+	for (int i=1; i<argc; i++) {
+		if (strcmp(argv[i],"-O0")==0) {
+			optimize=false;
+		}
+		else if (strcmp(argv[i],"--dump-ir")==0) {
+			dumpIR=true;
+		}
+		else if (strcmp(argv[i],"--interpret")==0) {
+			interpret=true;
+		}
+		else if (strcmp(argv[i],"--emit=c")==0) {
+			emitC=true;
+		}
+		else if (strcmp(argv[i],"--stats")==0) {
+			stats=true;
+		}
+		else if (strcmp(argv[i],"-g")==0 && i+1<argc) {
+			SourceFile=argv[++i];
+		}
+		else {
+			cerr<<"Usage: "<<argv[0]<<" [-O0] [-g program.p] [--stats] [--dump-ir | --interpret | --emit=c] < program.p > program.s"<<endl;
+			cerr<<"       "<<argv[0]<<" --server [socket]"<<endl;
+			return -1;
+		}
+	}
+	heap=HeapAllocations;
+	arena=CompilationArena.allocations;
+	try {
+		current=(TOKEN) lexer->yylex();															// Get first token
+		Program();
+		if (current!=FEOF) {
+			cerr<<"Unexpected characters at the end of the program: [" << current << "]";		// Unexpected characters at the end of the program
+			Error("."); 
+		}
+	}
+	catch (CompilationFailed&) {
+		return -1;
+	}
+	if (stats) {																				// The parser only allocates in the arena
+		cerr<<"Parsing: "<<HeapAllocations-heap<<" heap allocations, "<<CompilationArena.allocations-arena<<" arena allocations"<<endl;
 	}
-}
-		
-			
-
-
 
+	for (size_t f=0; f<Functions.size(); f++) {												// main, then the bodies of the PARALLEL FOR loops
+		SelectFunction(Functions[f]);
+		FinishSSA();
+		if (optimize) {
+			Optimize();
+		}
+	}
+	SelectFunction(Functions[0]);
+	if (dumpIR) {
+		DumpIR(cout);
+	}
+	else if (interpret) {
+		if (!Interpret(cout)) {																	// Division by zero
+			return -1;
+		}
+	}
+	else if (emitC) {
+		GenerateC(cout);
+	}
+	else {
+		GenerateCode(cout);
+	}
+	if (stats) {
+		cerr<<"Compilation: "<<HeapAllocations-heap<<" heap allocations, "<<CompilationArena.allocations-arena<<" arena allocations ("
+			<<CompilationArena.bytes<<" bytes in "<<CompilationArena.chunks<<" chunks)"<<endl;
+	}
+	return 0;
+}
 
+// Compile a program received by the compile server (server.cpp), starting from a clean state
+int CompileRequest(istream& source, int argc, char** argv){
+	DeclaredVariables=ArenaMap<const char*, TYPES>();											// Before the arena is reset by ResetIR()
+	TagNumber=0;
+	ValueStack=ArenaVector<Instruction*>();
+	ResetCodegen();
+	ResetIR();
+	lexer->Restart(&source);
+	return Compile(argc, argv);
+}
 
+int main(int argc, char** argv){
+	if (argc>1 && strcmp(argv[1],"--server")==0) {												// --server [socket] : compile server (see client.cpp)
+		return Serve(argc>2 ? argv[2] : DEFAULT_SOCKET);
+	}
+	return Compile(argc, argv);
+}
@@ -0,0 +1,572 @@
+// ir.cpp : construction of the SSA intermediate representation, analyses and textual dump
+// Build with "g++ -c ir.cpp"
+
+#include "ir.h"
+#include "arena.h"
+#include <cstring>
+#include <new>
+#include <algorithm>
+
+using namespace std;
+
+ArenaVector<Block*> Blocks;							// Every block of the selected function, in the order the parser started them
+ArenaVector<Function*> Functions;					// main first
+Function* CurrentFunction=NULL;
+Block* CurrentBlock=NULL;							// Block where new instructions are appended
+unsigned long SourceLine=0;							// Line of the statement or expression being parsed
+const char* SourceFile=NULL;						// -g : debug information is generated for this file
+ArenaVector<pair<const char*, TYPES> > Variables;	// Declared variables, in the order they appear in .data
+
+static unsigned long InstructionNumber=0;			// Used to number instructions (%id)
+static unsigned long BlockNumber=0;					// Used to number blocks
+
+static const char* TypeNames[]={"INTEGER", "BOOLEAN", "DOUBLE", "CHAR", "WTFT"};
+static const char* OpcodeNames[]={"const", "phi", "add", "sub", "mul", "div", "mod", "and", "or",
+	"equ", "diff", "inf", "sup", "infe", "supe", "select", "load", "arg", "store", "display", "parallel", "reduce",
+	"jump", "branch", "ret"};
+
+// 'label' must outlive the compilation : a string literal, or a string of the arena
+Function* NewFunction(const char* label) {
+	Function* function=new (Allocate(CompilationArena, sizeof(Function))) Function;
+	function->label=label;
+	Functions.push_back(function);
+	return function;
+}
+
+// The blocks of the selected function are in Blocks, where the parser, the passes and the back-ends find them
+void SelectFunction(Function* function) {
+	if (CurrentFunction!=NULL) {
+		swap(Blocks, CurrentFunction->blocks);
+	}
+	swap(Blocks, function->blocks);
+	CurrentFunction=function;
+}
+
+Block* NewBlock(const char* label) {
+	Block* block=new (Allocate(CompilationArena, sizeof(Block))) Block;
+	block->id=BlockNumber++;
+	block->label=label;
+	block->sealed=false;
+	block->idom=NULL;
+	block->rpo=-1;
+	return block;
+}
+
+// Label made of the name of the construct and its tag, as in "WHILE12"
+Block* NewBlock(const char* label, unsigned long tag) {
+	return NewBlock(Format(CompilationArena, "%s%lu", label, tag));
+}
+
+// The block is placed after the previous one and becomes the current block
+void StartBlock(Block* block) {
+	Blocks.push_back(block);
+	CurrentBlock=block;
+}
+
+static Instruction* NewInstruction(OPCODE op, TYPES type, Block* block) {
+	Instruction* instruction=new (Allocate(CompilationArena, sizeof(Instruction))) Instruction;
+	instruction->id=InstructionNumber++;
+	instruction->op=op;
+	instruction->type=type;
+	instruction->imm=0;
+	instruction->var=NULL;
+	instruction->block=block;
+	instruction->replacement=NULL;
+	instruction->line=SourceLine;
+	return instruction;
+}
+
+// Append an instruction to the current block
+Instruction* Emit(OPCODE op, TYPES type, Instruction* a, Instruction* b) {
+	Instruction* instruction=NewInstruction(op, type, CurrentBlock);
+	if (a!=NULL) {
+		instruction->args.push_back(a);
+	}
+	if (b!=NULL) {
+		instruction->args.push_back(b);
+	}
+	CurrentBlock->code.push_back(instruction);
+	return instruction;
+}
+
+Instruction* Constant(TYPES type, unsigned long long imm) {
+	Instruction* instruction=Emit(OP_CONST, type);
+	instruction->imm=imm;
+	return instruction;
+}
+
+static void AddEdge(Block* from, Block* to) {
+	from->succs.push_back(to);
+	to->preds.push_back(from);
+}
+
+// Terminators close the current block : the parser must start a new one before emitting more code
+void Jump(Block* target) {
+	Emit(OP_JUMP, WTFT);
+	AddEdge(CurrentBlock, target);
+	CurrentBlock=NULL;
+}
+
+void Branch(Instruction* condition, Block* iftrue, Block* iffalse) {
+	Emit(OP_BRANCH, BOOLEAN, condition);
+	AddEdge(CurrentBlock, iftrue);
+	AddEdge(CurrentBlock, iffalse);
+	CurrentBlock=NULL;
+}
+
+// Write the current value of every variable to .data
+void StoreVariables(void) {
+	for (size_t v=0; v<Variables.size(); v++) {
+		Instruction* store=Emit(OP_STORE, Variables[v].second, ReadVariable(Variables[v].first, Variables[v].second));
+		store->var=Variables[v].first;
+	}
+}
+
+// The variables are only written back to .data when the program ends : inside the program, they are SSA values
+void Return(void) {
+	StoreVariables();
+	Emit(OP_RET, WTFT);
+	CurrentBlock=NULL;
+}
+
+// Forget the program, before compiling another one
+// Blocks and instructions are not destroyed : everything they contain is in the arena
+void ResetIR(void) {
+	Blocks=ArenaVector<Block*>();
+	Functions=ArenaVector<Function*>();
+	CurrentFunction=NULL;
+	Variables=ArenaVector<pair<const char*, TYPES> >();
+	CurrentBlock=NULL;
+	InstructionNumber=0;
+	BlockNumber=0;
+	SourceLine=0;
+	ResetArena(CompilationArena);
+}
+
+// Follow the chain of replacements of a value
+Instruction* Resolve(Instruction* value) {
+	while (value->replacement!=NULL) {
+		value=value->replacement;
+	}
+	return value;
+}
+
+// A variable read before any assignment holds 0, its initial value in .data
+static Instruction* Undefined(TYPES type) {
+	Block* entry=Blocks[0];
+	Instruction* zero=NewInstruction(OP_CONST, type, entry);
+	entry->code.insert(entry->code.begin(), zero);
+	return zero;
+}
+
+// -g : the code generator tells the debugger where 'value' is while it is the value of the variable
+static void Name(const char* var, Instruction* value, Block* block) {
+	if (SourceFile!=NULL) {
+		Assignment assignment={var, value, block};
+		CurrentFunction->assignments.push_back(assignment);
+	}
+}
+
+// In the body of a PARALLEL FOR, a variable read before any assignment holds the value main stored in .data
+static Instruction* Captured(const char* var, TYPES type) {
+	Block* entry=Blocks[0];
+	Instruction* load=NewInstruction(OP_LOAD, type, entry);
+	load->var=var;
+	entry->code.insert(entry->code.begin(), load);
+	Name(var, load, entry);
+	return load;
+}
+
+static Instruction* NewPhi(const char* var, TYPES type, Block* block) {
+	Instruction* phi=NewInstruction(OP_PHI, type, block);
+	phi->var=var;
+	block->phis.push_back(phi);
+	Name(var, phi, block);
+	return phi;
+}
+
+// A PHI whose operands are all the same value (or the PHI itself) is replaced by that value
+static Instruction* TryRemoveTrivialPhi(Instruction* phi) {
+	Instruction* same=NULL;
+	for (size_t i=0; i<phi->args.size(); i++) {
+		Instruction* arg=Resolve(phi->args[i]);
+		if (arg==same || arg==phi) {
+			continue;
+		}
+		if (same!=NULL) {
+			return phi;							// At least two different values : the PHI is needed
+		}
+		same=arg;
+	}
+	if (same==NULL) {
+		same=Undefined(phi->type);				// Only reachable through itself
+	}
+	phi->replacement=same;
+	return same;
+}
+
+static Instruction* ReadVariableIn(const char* var, TYPES type, Block* block);
+
+static Instruction* AddPhiOperands(Instruction* phi) {
+	Block* block=phi->block;
+	for (size_t i=0; i<block->preds.size(); i++) {
+		phi->args.push_back(ReadVariableIn(phi->var, phi->type, block->preds[i]));
+	}
+	return TryRemoveTrivialPhi(phi);
+}
+
+static Instruction* ReadVariableIn(const char* var, TYPES type, Block* block) {
+	Instruction* value;
+	ArenaMap<const char*, Instruction*, NameOrder>::iterator it=block->definitions.find(var);
+	if (it!=block->definitions.end()) {
+		return Resolve(it->second);				// Assigned in this block, or already looked up
+	}
+	if (!block->sealed) {						// Predecessors still unknown : operands are added by SealBlock
+		value=NewPhi(var, type, block);
+		block->incomplete[var]=value;
+	}
+	else if (block->preds.empty()) {			// Entry block
+		value=CurrentFunction==Functions[0] ? Undefined(type) : Captured(var, type);
+	}
+	else if (block->preds.size()==1) {			// No join : no PHI needed
+		value=ReadVariableIn(var, type, block->preds[0]);
+	}
+	else {
+		Instruction* phi=NewPhi(var, type, block);
+		block->definitions[var]=phi;			// Breaks cycles through loops
+		value=AddPhiOperands(phi);
+	}
+	block->definitions[var]=value;
+	return value;
+}
+
+// Assignment : the variable now holds 'value' in the current block
+void WriteVariable(const char* var, Instruction* value) {
+	CurrentBlock->definitions[var]=value;
+	Name(var, value, CurrentBlock);
+}
+
+Instruction* ReadVariable(const char* var, TYPES type) {
+	return ReadVariableIn(var, type, CurrentBlock);
+}
+
+// Called once every predecessor of the block has been connected
+void SealBlock(Block* block) {
+	for (ArenaMap<const char*, Instruction*, NameOrder>::iterator it=block->incomplete.begin(); it!=block->incomplete.end(); ++it) {
+		AddPhiOperands(it->second);
+	}
+	block->incomplete.clear();
+	block->sealed=true;
+}
+
+// Rewrite operands to their final values and drop the instructions that have been replaced
+void ResolveOperands(void) {
+	for (size_t b=0; b<Blocks.size(); b++) {
+		Block* block=Blocks[b];
+		ArenaVector<Instruction*>* lists[2]={&block->phis, &block->code};
+		for (int l=0; l<2; l++) {
+			ArenaVector<Instruction*>& list=*lists[l];
+			size_t kept=0;
+			for (size_t i=0; i<list.size(); i++) {
+				Instruction* instruction=list[i];
+				if (instruction->replacement!=NULL) {
+					continue;
+				}
+				for (size_t a=0; a<instruction->args.size(); a++) {
+					instruction->args[a]=Resolve(instruction->args[a]);
+				}
+				list[kept++]=instruction;
+			}
+			list.resize(kept);
+		}
+	}
+}
+
+// Remove the PHIs that turned out to be trivial once all the blocks were sealed
+void FinishSSA(void) {
+	bool changed=true;
+	while (changed) {
+		changed=false;
+		for (size_t b=0; b<Blocks.size(); b++) {
+			for (size_t i=0; i<Blocks[b]->phis.size(); i++) {
+				Instruction* phi=Blocks[b]->phis[i];
+				if (phi->replacement==NULL && TryRemoveTrivialPhi(phi)!=phi) {
+					changed=true;
+				}
+			}
+		}
+	}
+	ResolveOperands();
+}
+
+bool IsTerminator(OPCODE op) {
+	return op==OP_JUMP || op==OP_BRANCH || op==OP_RET;
+}
+
+// Instructions without side effects, whose value only depends on their operands
+bool IsPure(OPCODE op) {
+	return op==OP_CONST || (op>=OP_ADD && op<=OP_SELECT);
+}
+
+// Instructions that define a value
+bool HasValue(OPCODE op) {
+	return op==OP_PHI || op==OP_LOAD || op==OP_ARG || IsPure(op);
+}
+
+bool IsComparison(OPCODE op) {
+	return op>=OP_EQU && op<=OP_SUPE;
+}
+
+static double AsDouble(unsigned long long bits) {
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+static unsigned long long AsBits(double d) {
+	unsigned long long bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+// Compute 'a op b' as the generated code would; 'type' is the type of the operands.
+// Returns false when the result cannot be known at compile time (division by zero).
+bool Evaluate(OPCODE op, TYPES type, unsigned long long a, unsigned long long b, unsigned long long& result) {
+	if (type==DOUBLE) {
+		double x=AsDouble(a), y=AsDouble(b);
+		switch (op) {
+			case OP_ADD: result=AsBits(x+y); return true;
+			case OP_SUB: result=AsBits(x-y); return true;
+			case OP_MUL: result=AsBits(x*y); return true;
+			case OP_DIV: result=AsBits(x/y); return true;
+			// An unordered comparison (NaN) sets ZF, CF and PF : the flags are the ones of 'equal' and 'below'
+			case OP_EQU: result=(x==y || x!=x || y!=y) ? ~0ULL : 0; return true;
+			case OP_DIFF: result=(x==y || x!=x || y!=y) ? 0 : ~0ULL; return true;
+			case OP_INF: result=(x<y || x!=x || y!=y) ? ~0ULL : 0; return true;
+			case OP_INFE: result=(x<=y || x!=x || y!=y) ? ~0ULL : 0; return true;
+			case OP_SUP: result=(x>y) ? ~0ULL : 0; return true;
+			case OP_SUPE: result=(x>=y) ? ~0ULL : 0; return true;
+			default: return false;
+		}
+	}
+	switch (op) {
+		case OP_ADD: case OP_OR: result=a+b; return true;
+		case OP_SUB: result=a-b; return true;
+		case OP_MUL: case OP_AND: result=a*b; return true;
+		case OP_DIV: if (b==0) return false; result=a/b; return true;
+		case OP_MOD: if (b==0) return false; result=a%b; return true;
+		case OP_EQU: result=(a==b) ? ~0ULL : 0; return true;
+		case OP_DIFF: result=(a!=b) ? ~0ULL : 0; return true;
+		case OP_INF: result=(a<b) ? ~0ULL : 0; return true;
+		case OP_SUP: result=(a>b) ? ~0ULL : 0; return true;
+		case OP_INFE: result=(a<=b) ? ~0ULL : 0; return true;
+		case OP_SUPE: result=(a>=b) ? ~0ULL : 0; return true;
+		default: return false;
+	}
+}
+
+// Reverse post-order numbering, then immediate dominators
+// (Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm")
+void ComputeDominators(void) {
+	PassVector<Block*> order;						// Post-order
+	PassVector<pair<Block*, size_t> > stack;
+	for (size_t b=0; b<Blocks.size(); b++) {
+		Blocks[b]->rpo=-1;
+		Blocks[b]->idom=NULL;
+	}
+	Blocks[0]->rpo=0;								// Marks the block as visited
+	stack.push_back(make_pair(Blocks[0], 0));
+	while (!stack.empty()) {						// Iterative depth-first search (programs can be deeply nested)
+		Block* block=stack.back().first;
+		size_t next=stack.back().second++;
+		if (next<block->succs.size()) {
+			Block* succ=block->succs[next];
+			if (succ->rpo==-1) {
+				succ->rpo=0;
+				stack.push_back(make_pair(succ, 0));
+			}
+		}
+		else {
+			order.push_back(block);
+			stack.pop_back();
+		}
+	}
+	reverse(order.begin(), order.end());
+	for (size_t i=0; i<order.size(); i++) {
+		order[i]->rpo=i;
+	}
+
+	Blocks[0]->idom=Blocks[0];
+	bool changed=true;
+	while (changed) {
+		changed=false;
+		for (size_t i=1; i<order.size(); i++) {
+			Block* block=order[i];
+			Block* idom=NULL;
+			for (size_t p=0; p<block->preds.size(); p++) {
+				Block* pred=block->preds[p];
+				if (pred->idom==NULL) {
+					continue;						// Not processed yet (or unreachable)
+				}
+				if (idom==NULL) {
+					idom=pred;
+					continue;
+				}
+				Block* a=pred;
+				Block* b=idom;
+				while (a!=b) {						// Intersect the two dominator chains
+					while (a->rpo>b->rpo) a=a->idom;
+					while (b->rpo>a->rpo) b=b->idom;
+				}
+				idom=a;
+			}
+			if (block->idom!=idom) {
+				block->idom=idom;
+				changed=true;
+			}
+		}
+	}
+
+	PassVector<PassVector<Block*> > children(order.size());	// Dominator tree, numbered so Dominates() does not walk it
+	int number=0;
+	for (size_t i=1; i<order.size(); i++) {
+		children[order[i]->idom->rpo].push_back(order[i]);
+	}
+	Blocks[0]->enter=number++;
+	stack.push_back(make_pair(Blocks[0], 0));
+	while (!stack.empty()) {
+		Block* block=stack.back().first;
+		size_t next=stack.back().second++;
+		if (next<children[block->rpo].size()) {
+			Block* child=children[block->rpo][next];
+			child->enter=number++;
+			stack.push_back(make_pair(child, 0));
+		}
+		else {
+			block->leave=number++;
+			stack.pop_back();
+		}
+	}
+}
+
+// True if every path from the entry to 'b' goes through 'a'
+bool Dominates(Block* a, Block* b) {
+	if (a->rpo==-1 || b->rpo==-1) {
+		return false;								// Unreachable
+	}
+	return a->enter<=b->enter && b->leave<=a->leave;
+}
+
+static void DumpValue(ostream& out, Instruction* value) {
+	out<<"%"<<value->id;
+}
+
+static void DumpConstant(ostream& out, Instruction* constant) {
+	switch (constant->type) {
+		case DOUBLE:
+			out<<AsDouble(constant->imm);
+			break;
+		case BOOLEAN:
+			if (constant->imm==0) out<<"FALSE";
+			else if (constant->imm==~0ULL) out<<"TRUE";
+			else out<<constant->imm;
+			break;
+		case CHAR:
+			out<<"'"<<(char) constant->imm<<"'";
+			break;
+		default:
+			out<<constant->imm;
+	}
+}
+
+static void DumpInstruction(ostream& out, Instruction* instruction) {
+	Block* block=instruction->block;
+	out<<"\t";
+	switch (instruction->op) {
+		case OP_STORE:
+			out<<"store\t"<<instruction->var<<", ";
+			DumpValue(out, instruction->args[0]);
+			break;
+		case OP_DISPLAY:
+			out<<"display\t"<<TypeNames[instruction->type]<<" ";
+			DumpValue(out, instruction->args[0]);
+			break;
+		case OP_PARALLEL:
+			out<<"parallel\t"<<instruction->var<<", ";
+			DumpValue(out, instruction->args[0]);
+			out<<", ";
+			DumpValue(out, instruction->args[1]);
+			break;
+		case OP_REDUCE:
+			out<<"reduce\t"<<instruction->var<<", "<<OpcodeNames[instruction->imm]<<" ";
+			DumpValue(out, instruction->args[0]);
+			break;
+		case OP_JUMP:
+			out<<"jump\t"<<block->succs[0]->label;
+			break;
+		case OP_BRANCH:
+			out<<"branch\t";
+			DumpValue(out, instruction->args[0]);
+			out<<", "<<block->succs[0]->label<<", "<<block->succs[1]->label;
+			break;
+		case OP_RET:
+			out<<"ret";
+			break;
+		default:
+			DumpValue(out, instruction);
+			out<<" = "<<OpcodeNames[instruction->op]<<"\t"<<TypeNames[instruction->type]<<" ";
+			if (instruction->op==OP_CONST) {
+				DumpConstant(out, instruction);
+			}
+			else if (instruction->op==OP_LOAD) {
+				out<<instruction->var;
+			}
+			else if (instruction->op==OP_ARG) {
+				out<<instruction->imm;
+			}
+			for (size_t a=0; a<instruction->args.size(); a++) {
+				if (a>0) out<<", ";
+				if (instruction->op==OP_PHI) out<<"[";
+				DumpValue(out, instruction->args[a]);
+				if (instruction->op==OP_PHI) out<<" "<<block->preds[a]->label<<"]";
+			}
+			if (instruction->op==OP_PHI) {
+				out<<"\t\t; "<<instruction->var;
+			}
+	}
+	out<<endl;
+}
+
+// Blocks of the selected function
+static void DumpFunction(ostream& out) {
+	for (size_t b=0; b<Blocks.size(); b++) {
+		Block* block=Blocks[b];
+		out<<endl<<block->label<<":";
+		if (!block->preds.empty()) {
+			out<<"\t\t\t; preds:";
+			for (size_t p=0; p<block->preds.size(); p++) {
+				out<<" "<<block->preds[p]->label;
+			}
+		}
+		out<<endl;
+		for (size_t i=0; i<block->phis.size(); i++) {
+			DumpInstruction(out, block->phis[i]);
+		}
+		for (size_t i=0; i<block->code.size(); i++) {
+			DumpInstruction(out, block->code[i]);
+		}
+	}
+}
+
+// Textual form of the IR, one block per paragraph : main, then the bodies of the PARALLEL FOR loops
+void DumpIR(ostream& out) {
+	Function* selected=CurrentFunction;
+	for (size_t v=0; v<Variables.size(); v++) {
+		out<<"var "<<Variables[v].first<<" : "<<TypeNames[Variables[v].second]<<endl;
+	}
+	for (size_t f=0; f<Functions.size(); f++) {
+		SelectFunction(Functions[f]);
+		DumpFunction(out);
+	}
+	SelectFunction(selected);
+}
@@ -0,0 +1,138 @@
+// ir.h : intermediate representation shared by compiler.cpp, optimizer.cpp and the back-ends
+// The parser lowers the program into a control flow graph (CFG) of basic blocks in SSA form :
+// every Instruction defines at most one value, and each assignment to a variable creates a new value.
+// Where control flow joins, PHI instructions select the value coming from the predecessor that was taken.
+// SSA values are built while parsing (Braun et al., "Simple and Efficient Construction of SSA Form").
+
+#ifndef IR_H
+#define IR_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <cstring>
+#include "arena.h"
+
+enum TYPES {INTEGER, BOOLEAN, DOUBLE, CHAR ,WTFT};
+
+enum OPCODE {
+	OP_CONST,										// 64-bit constant (bit pattern for DOUBLE)
+	OP_PHI,											// one operand per predecessor of the block
+	OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,			// arithmetic, on unsigned 64-bit integers or doubles
+	OP_AND, OP_OR,									// BOOLEAN operators (computed as product and sum, like '&&' and '||' always were)
+	OP_EQU, OP_DIFF, OP_INF, OP_SUP, OP_INFE, OP_SUPE,	// comparisons, BOOLEAN result (0 or 0xFFFFFFFFFFFFFFFF)
+	OP_SELECT,										// args[0] ? args[1] : args[2], made by if-conversion
+	OP_LOAD,										// value of the .data variable 'var'
+	OP_ARG,											// argument number imm of a PARALLEL FOR body (0 : first iteration, 1 : end)
+	OP_STORE,										// copy a value into the .data variable 'var'
+	OP_DISPLAY,										// print a value followed by a newline
+	OP_PARALLEL,									// run the function 'var' for the iterations args[0] to args[1] (excluded)
+	OP_REDUCE,										// atomically combine args[0] into the .data variable 'var' with the operation imm
+	OP_JUMP, OP_BRANCH, OP_RET						// terminators
+};
+
+struct Block;
+
+struct NameOrder {									// Variables in alphabetical order, as the parser declares them
+	bool operator()(const char* a, const char* b) const {
+		return strcmp(a, b)<0;
+	}
+};
+
+struct Instruction {
+	unsigned long id;								// unique number, printed as %id
+	OPCODE op;
+	TYPES type;										// type of the value (type of the operand for STORE and DISPLAY)
+	unsigned long long imm;							// OP_CONST value
+	const char* var;								// variable (interned) of OP_STORE, OP_LOAD, OP_REDUCE and OP_PHI, function of OP_PARALLEL
+	ArenaVector<Instruction*> args;					// operands (for OP_PHI, args[i] comes from block->preds[i])
+	Block* block;									// block containing the instruction
+	Instruction* replacement;						// set when the value has been replaced by another one (trivial PHI, CSE)
+	unsigned long line;								// line of the source program, 0 if unknown
+};
+
+struct Block {
+	unsigned long id;
+	const char* label;								// assembly label, named after the construct that created the block
+	ArenaVector<Instruction*> phis;
+	ArenaVector<Instruction*> code;					// the last instruction is the terminator
+	ArenaVector<Block*> preds, succs;				// for OP_BRANCH, succs[0] is taken when the condition is TRUE
+	bool sealed;									// all predecessors are known
+	ArenaMap<const char*, Instruction*, NameOrder> definitions;	// current value of each variable in the block
+	ArenaMap<const char*, Instruction*, NameOrder> incomplete;	// PHIs created before the block was sealed
+	Block* idom;									// immediate dominator (ComputeDominators)
+	int rpo;										// reverse post-order number, -1 if unreachable (ComputeDominators)
+	int enter, leave;								// depth-first numbering of the dominator tree (ComputeDominators)
+};
+
+struct Assignment {									// -g : 'var' holds 'value' from the block 'block' on
+	const char* var;
+	Instruction* value;
+	Block* block;
+};
+
+struct Function {
+	const char* label;								// name of the function in the assembly code
+	ArenaVector<Block*> blocks;						// its blocks, while another function is selected
+	ArenaVector<Assignment> assignments;			// -g : values given to the variables (assignments, PHIs, loads)
+};
+
+extern ArenaVector<Block*> Blocks;					// every block of the selected function, in layout order
+extern ArenaVector<Function*> Functions;			// main, then the bodies of the PARALLEL FOR loops
+extern Function* CurrentFunction;					// the function whose blocks are in Blocks
+extern Block* CurrentBlock;							// block where instructions are appended
+extern ArenaVector<std::pair<const char*, TYPES> > Variables;	// declared variables (interned names), in .data order
+extern unsigned long SourceLine;					// set by the parser, recorded in the instructions it emits
+extern const char* SourceFile;						// name of the source program for the debug information, NULL if none
+
+// Construction (ir.cpp)
+Function* NewFunction(const char* label);
+void SelectFunction(Function* function);
+Block* NewBlock(const char* label);
+Block* NewBlock(const char* label, unsigned long tag);
+void StartBlock(Block* block);
+Instruction* Emit(OPCODE op, TYPES type, Instruction* a=NULL, Instruction* b=NULL);
+Instruction* Constant(TYPES type, unsigned long long imm);
+void Jump(Block* target);
+void Branch(Instruction* condition, Block* iftrue, Block* iffalse);
+void Return(void);
+void StoreVariables(void);
+void WriteVariable(const char* var, Instruction* value);
+Instruction* ReadVariable(const char* var, TYPES type);
+void SealBlock(Block* block);
+void ResolveOperands(void);
+void FinishSSA(void);
+void ResetIR(void);
+
+// Helpers (ir.cpp)
+Instruction* Resolve(Instruction* value);
+bool IsTerminator(OPCODE op);
+bool IsPure(OPCODE op);
+bool HasValue(OPCODE op);
+bool IsComparison(OPCODE op);
+bool Evaluate(OPCODE op, TYPES type, unsigned long long a, unsigned long long b, unsigned long long& result);
+void ComputeDominators(void);
+bool Dominates(Block* a, Block* b);
+void DumpIR(std::ostream& out);
+
+// Passes (optimizer.cpp)
+void GlobalValueNumbering(void);
+void LoopInvariantCodeMotion(void);
+void DeadCodeElimination(void);
+void RemoveEmptyBlocks(void);
+void RotateLoops(void);
+void IfConversion(void);
+void Optimize(void);
+
+// x86-64 backend (codegen.cpp)
+void GenerateCode(std::ostream& out);
+void ResetCodegen(void);
+
+// Bytecode interpreter (vm.cpp)
+bool Interpret(std::ostream& out);
+
+// C backend (cbackend.cpp)
+void GenerateC(std::ostream& out);
+
+#endif
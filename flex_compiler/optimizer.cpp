@@ -0,0 +1,531 @@
+// optimizer.cpp : optimization passes on the SSA intermediate representation
+// Build with "g++ -c optimizer.cpp"
+
+#include "ir.h"
+#include <algorithm>
+
+using namespace std;
+
+typedef PassVector<unsigned long long> KEY;		// What makes two values equal : opcode, type, constant and operands
+
+static bool IsCommutative(OPCODE op) {
+	return op==OP_ADD || op==OP_MUL || op==OP_AND || op==OP_OR || op==OP_EQU || op==OP_DIFF;
+}
+
+// Key of a pure instruction or a PHI, with operands already replaced by their value number
+static KEY ValueKey(Instruction* instruction) {
+	OPCODE op=instruction->op;
+	Instruction* a=instruction->args.size()>0 ? instruction->args[0] : NULL;
+	Instruction* b=instruction->args.size()>1 ? instruction->args[1] : NULL;
+	if ((op==OP_SUP || op==OP_SUPE) && a->type!=DOUBLE) {	// a>b is b<a, a>=b is b<=a, but not with a NaN
+		op=(op==OP_SUP) ? OP_INF : OP_INFE;
+		swap(a, b);
+	}
+	KEY key;
+	key.reserve(3+instruction->args.size()+(op==OP_PHI));	// Grown once : the arena does not reuse the memory
+	key.push_back(op);
+	key.push_back(instruction->type);
+	key.push_back(instruction->imm);
+	if (op==OP_PHI) {								// PHIs are only equal within the same block
+		key.push_back(instruction->block->id);
+		for (size_t i=0; i<instruction->args.size(); i++) {
+			key.push_back(instruction->args[i]->id);
+		}
+		return key;
+	}
+	if (b!=NULL && IsCommutative(op) && b->id<a->id) {
+		swap(a, b);
+	}
+	if (a!=NULL) key.push_back(a->id);
+	if (b!=NULL) key.push_back(b->id);
+	for (size_t i=2; i<instruction->args.size(); i++) {	// OP_SELECT
+		key.push_back(instruction->args[i]->id);
+	}
+	return key;
+}
+
+// Replace an operation on constants by its result
+static void FoldConstant(Instruction* instruction) {
+	if (!IsPure(instruction->op) || instruction->op==OP_CONST || instruction->args.size()!=2) {
+		return;
+	}
+	Instruction* a=instruction->args[0];
+	Instruction* b=instruction->args[1];
+	unsigned long long result;
+	if (a->op!=OP_CONST || b->op!=OP_CONST) {
+		return;
+	}
+	if (!Evaluate(instruction->op, a->type, a->imm, b->imm, result)) {
+		return;										// Division by zero is left to the program
+	}
+	instruction->op=OP_CONST;
+	instruction->imm=result;
+	instruction->args.clear();
+}
+
+// Dominator-based global value numbering : walking the dominator tree, each pure instruction is
+// looked up in a table of the values available in its dominators, and replaced when found there
+// (common subexpression elimination). Constants are folded on the way.
+void GlobalValueNumbering(void) {
+	PassMap<Block*, PassVector<Block*> > children;	// Dominator tree
+	PassMap<Block*, size_t> index;					// Next child to visit
+	PassMap<KEY, Instruction*> available;
+	PassVector<KEY> undo;							// Keys added to the table, removed when leaving a subtree
+	PassVector<pair<Block*, size_t> > stack;		// (block, size of 'undo' when the block was entered)
+
+	ComputeDominators();
+	for (size_t b=1; b<Blocks.size(); b++) {
+		if (Blocks[b]->idom!=NULL) {
+			children[Blocks[b]->idom].push_back(Blocks[b]);
+		}
+	}
+
+	stack.push_back(make_pair(Blocks[0], 0));
+	while (!stack.empty()) {
+		Block* block=stack.back().first;
+		size_t mark=stack.back().second;
+		if (index.find(block)==index.end()) {		// First visit : number the values of the block
+			ArenaVector<Instruction*>* lists[2]={&block->phis, &block->code};
+			for (int l=0; l<2; l++) {
+				for (size_t i=0; i<lists[l]->size(); i++) {
+					Instruction* instruction=(*lists[l])[i];
+					if (instruction->replacement!=NULL) {
+						continue;
+					}
+					for (size_t a=0; a<instruction->args.size(); a++) {
+						instruction->args[a]=Resolve(instruction->args[a]);
+					}
+					if (instruction->op!=OP_PHI && !IsPure(instruction->op)) {
+						continue;
+					}
+					if (instruction->op==OP_PHI) {	// A PHI whose operands are all the same value is that value
+						bool same=true;
+						for (size_t a=1; a<instruction->args.size(); a++) {
+							same=same && instruction->args[a]==instruction->args[0];
+						}
+						if (same && !instruction->args.empty() && instruction->args[0]!=instruction) {
+							instruction->replacement=instruction->args[0];
+							continue;
+						}
+					}
+					FoldConstant(instruction);
+					KEY key=ValueKey(instruction);
+					PassMap<KEY, Instruction*>::iterator it=available.find(key);
+					if (it!=available.end()) {
+						instruction->replacement=it->second;		// Redundant : reuse the dominating value
+					}
+					else {
+						undo.push_back(key);
+						available[key]=instruction;
+					}
+				}
+			}
+		}
+		size_t& next=index[block];
+		if (next<children[block].size()) {
+			Block* child=children[block][next++];
+			stack.push_back(make_pair(child, undo.size()));
+		}
+		else {										// Leaving the subtree : forget its values
+			while (undo.size()>mark) {
+				available.erase(undo.back());
+				undo.pop_back();
+			}
+			stack.pop_back();
+		}
+	}
+	ResolveOperands();
+}
+
+// Remove pure instructions and PHIs whose value is never used
+void DeadCodeElimination(void) {
+	PassMap<Instruction*, unsigned long> uses;
+	PassSet<Instruction*> dead;
+	PassVector<Instruction*> worklist;
+	for (size_t b=0; b<Blocks.size(); b++) {
+		ArenaVector<Instruction*>* lists[2]={&Blocks[b]->phis, &Blocks[b]->code};
+		for (int l=0; l<2; l++) {
+			for (size_t i=0; i<lists[l]->size(); i++) {
+				Instruction* instruction=(*lists[l])[i];
+				uses[instruction];
+				for (size_t a=0; a<instruction->args.size(); a++) {
+					if (instruction->args[a]!=instruction) {
+						uses[instruction->args[a]]++;
+					}
+				}
+			}
+		}
+	}
+	for (PassMap<Instruction*, unsigned long>::iterator it=uses.begin(); it!=uses.end(); ++it) {
+		if (it->second==0 && HasValue(it->first->op)) {
+			worklist.push_back(it->first);
+		}
+	}
+	while (!worklist.empty()) {
+		Instruction* instruction=worklist.back();
+		worklist.pop_back();
+		dead.insert(instruction);
+		for (size_t a=0; a<instruction->args.size(); a++) {
+			Instruction* arg=instruction->args[a];
+			if (arg!=instruction && --uses[arg]==0 && HasValue(arg->op)) {
+				worklist.push_back(arg);
+			}
+		}
+	}
+	for (size_t b=0; b<Blocks.size(); b++) {
+		ArenaVector<Instruction*>* lists[2]={&Blocks[b]->phis, &Blocks[b]->code};
+		for (int l=0; l<2; l++) {
+			ArenaVector<Instruction*>& list=*lists[l];
+			size_t kept=0;
+			for (size_t i=0; i<list.size(); i++) {
+				if (dead.find(list[i])==dead.end()) {
+					list[kept++]=list[i];
+				}
+			}
+			list.resize(kept);
+		}
+	}
+}
+
+// A natural loop : the header and every block that reaches a back edge to it without going through it
+struct Loop {
+	Block* header;
+	PassSet<Block*> blocks;
+};
+
+static bool Smaller(const Loop& a, const Loop& b) {
+	return a.blocks.size()<b.blocks.size();
+}
+
+static bool Earlier(Block* a, Block* b) {
+	return a->rpo<b->rpo;
+}
+
+// Loops of the CFG, innermost first
+static PassVector<Loop> FindLoops(void) {
+	PassMap<Block*, PassSet<Block*> > bodies;
+	PassVector<Loop> loops;
+	ComputeDominators();
+	for (size_t b=0; b<Blocks.size(); b++) {
+		Block* latch=Blocks[b];
+		if (latch->rpo==-1) {
+			continue;								// Unreachable
+		}
+		for (size_t s=0; s<latch->succs.size(); s++) {
+			Block* header=latch->succs[s];
+			if (!Dominates(header, latch)) {
+				continue;							// Not a back edge
+			}
+			PassSet<Block*>& body=bodies[header];
+			PassVector<Block*> worklist;
+			body.insert(header);
+			worklist.push_back(latch);
+			while (!worklist.empty()) {				// Walk backwards from the latch up to the header
+				Block* block=worklist.back();
+				worklist.pop_back();
+				if (body.insert(block).second) {
+					worklist.insert(worklist.end(), block->preds.begin(), block->preds.end());
+				}
+			}
+		}
+	}
+	for (PassMap<Block*, PassSet<Block*> >::iterator it=bodies.begin(); it!=bodies.end(); ++it) {
+		Loop loop;
+		loop.header=it->first;
+		loop.blocks=it->second;
+		loops.push_back(loop);
+	}
+	stable_sort(loops.begin(), loops.end(), Smaller);	// A loop nested in another one has fewer blocks
+	return loops;
+}
+
+// The block that enters the loop, if it only jumps to the header (the parser always builds loops this way)
+static Block* Preheader(Loop& loop) {
+	Block* preheader=NULL;
+	for (size_t p=0; p<loop.header->preds.size(); p++) {
+		Block* pred=loop.header->preds[p];
+		if (loop.blocks.count(pred)) {
+			continue;								// Back edge
+		}
+		if (preheader!=NULL) {
+			return NULL;							// Several ways in
+		}
+		preheader=pred;
+	}
+	if (preheader==NULL || preheader->succs.size()!=1) {
+		return NULL;
+	}
+	return preheader;
+}
+
+// Hoisted instructions may be executed even when the loop body is not : they must not trap
+static bool CanSpeculate(Instruction* instruction) {
+	if (!IsPure(instruction->op)) {
+		return false;
+	}
+	if ((instruction->op==OP_DIV || instruction->op==OP_MOD) && instruction->type!=DOUBLE) {
+		Instruction* divisor=instruction->args[1];
+		return divisor->op==OP_CONST && divisor->imm!=0;
+	}
+	return true;
+}
+
+// Loop-invariant code motion : an instruction whose operands are all defined outside a loop computes the same
+// value at every iteration. It is moved to the preheader, so it is computed once before the loop.
+// Variables that are not assigned in the loop are SSA values defined outside of it, so expressions such as
+// 'a * 3 + d' in a WHILE condition or in a FOR body are hoisted. Inner loops are processed first, so an
+// expression can move out of several nested loops.
+void LoopInvariantCodeMotion(void) {
+	PassVector<Loop> loops=FindLoops();
+	for (size_t l=0; l<loops.size(); l++) {
+		Loop& loop=loops[l];
+		Block* preheader=Preheader(loop);
+		if (preheader==NULL) {
+			continue;
+		}
+		PassVector<Block*> order(loop.blocks.begin(), loop.blocks.end());
+		sort(order.begin(), order.end(), Earlier);	// Dominators first, so operands are hoisted before their users
+		for (size_t b=0; b<order.size(); b++) {
+			Block* block=order[b];
+			ArenaVector<Instruction*> kept;
+			for (size_t i=0; i<block->code.size(); i++) {
+				Instruction* instruction=block->code[i];
+				bool invariant=CanSpeculate(instruction);
+				for (size_t a=0; invariant && a<instruction->args.size(); a++) {
+					invariant=loop.blocks.count(instruction->args[a]->block)==0;
+				}
+				if (!invariant) {
+					kept.push_back(instruction);
+					continue;
+				}
+				instruction->block=preheader;		// Computed before the jump to the header
+				preheader->code.insert(preheader->code.end()-1, instruction);
+			}
+			block->code=kept;
+		}
+	}
+}
+
+// Blocks that only jump to another block (such as WHILEend, or IFfalse when the IF has no ELSE) are removed :
+// their predecessors jump directly to the target, which receives their values for its PHIs.
+// A conditional branch never goes directly to a block with PHIs, so that the PHIs can be written before it.
+void RemoveEmptyBlocks(void) {
+	ArenaVector<Block*> kept;
+	kept.push_back(Blocks[0]);
+	for (size_t b=1; b<Blocks.size(); b++) {
+		Block* block=Blocks[b];
+		Block* target=block->succs.empty() ? NULL : block->succs[0];
+		bool empty=block->phis.empty() && block->code.size()==1 && block->code[0]->op==OP_JUMP && target!=block;
+		for (size_t p=0; empty && p<block->preds.size(); p++) {
+			Block* pred=block->preds[p];			// A branch whose two targets would be the same is kept,
+			empty=count(pred->succs.begin(), pred->succs.end(), target)==0	// and so is a branch to PHIs
+				&& count(pred->succs.begin(), pred->succs.end(), block)==1
+				&& (pred->succs.size()==1 || target->phis.empty());
+		}
+		if (!empty) {
+			kept.push_back(block);
+			continue;
+		}
+		size_t e=find(target->preds.begin(), target->preds.end(), block)-target->preds.begin();
+		PassVector<Instruction*> values;			// What the PHIs of the target receive from the removed block
+		for (size_t i=0; i<target->phis.size(); i++) {
+			values.push_back(target->phis[i]->args[e]);
+			target->phis[i]->args.erase(target->phis[i]->args.begin()+e);
+		}
+		target->preds.erase(target->preds.begin()+e);
+		for (size_t p=0; p<block->preds.size(); p++) {
+			Block* pred=block->preds[p];
+			*find(pred->succs.begin(), pred->succs.end(), block)=target;
+			target->preds.push_back(pred);
+			for (size_t i=0; i<target->phis.size(); i++) {
+				target->phis[i]->args.push_back(values[i]);
+			}
+		}
+	}
+	Blocks=kept;
+}
+
+// Loop rotation : the parser puts the test of a WHILE or FOR loop at the top, and the last block of the body
+// jumps back to it, so each iteration takes two branches. The test block is moved after the body : the body
+// falls through into the test, whose conditional branch goes back to the top of the body. The loop is entered
+// by a jump to the test, which guards the first iteration. No code is duplicated, so SSA form is untouched.
+void RotateLoops(void) {
+	PassVector<Loop> loops=FindLoops();
+	PassMap<Block*, size_t> position;
+	PassMap<Block*, PassVector<Block*> > after;		// Tests to place after a block, innermost loop first
+	PassSet<Block*> moved;
+	for (size_t b=0; b<Blocks.size(); b++) {
+		position[Blocks[b]]=b;
+	}
+	for (size_t l=0; l<loops.size(); l++) {
+		Block* header=loops[l].header;
+		Instruction* test=header->code.back();
+		if (header==Blocks[0] || test->op!=OP_BRANCH
+			|| loops[l].blocks.count(header->succs[0])==loops[l].blocks.count(header->succs[1])) {
+			continue;								// The header is not the test that leaves the loop
+		}
+		Block* last=header;							// Last block of the loop in the layout
+		for (PassSet<Block*>::iterator it=loops[l].blocks.begin(); it!=loops[l].blocks.end(); ++it) {
+			if (position[*it]>position[last]) {
+				last=*it;
+			}
+		}
+		if (last!=header) {
+			after[last].push_back(header);
+			moved.insert(header);
+		}
+	}
+	ArenaVector<Block*> layout;
+	for (size_t b=0; b<Blocks.size(); b++) {
+		if (moved.count(Blocks[b])) {
+			continue;
+		}
+		PassVector<Block*> pending(1, Blocks[b]);
+		while (!pending.empty()) {
+			Block* block=pending.back();
+			pending.pop_back();
+			layout.push_back(block);
+			PassVector<Block*>& tests=after[block];
+			pending.insert(pending.end(), tests.rbegin(), tests.rend());
+		}
+	}
+	Blocks=layout;
+}
+
+static const size_t MaxConverted=4;					// Operations of the two arms of an IF that may all be executed
+
+// An arm of an IF that can be executed whatever the condition : a block that only computes values.
+// 'arm' is NULL when the branch goes directly to the join (IF without ELSE).
+static bool IsSimpleArm(Block* arm, Block* join, size_t& cost) {
+	if (arm==NULL) {
+		return true;
+	}
+	if (arm->preds.size()!=1 || arm->succs.size()!=1 || arm->succs[0]!=join || !arm->phis.empty()) {
+		return false;
+	}
+	for (size_t i=0; i+1<arm->code.size(); i++) {
+		Instruction* instruction=arm->code[i];
+		if (!CanSpeculate(instruction)) {
+			return false;
+		}
+		if (instruction->op!=OP_CONST) {
+			cost++;
+		}
+	}
+	return true;
+}
+
+// condition ? iftrue : iffalse, appended to the current block
+static Instruction* Select(PassVector<Instruction*>& selects, Instruction* condition, Instruction* iftrue, Instruction* iffalse) {
+	if (iftrue==iffalse) {
+		return iftrue;
+	}
+	if (condition->op==OP_CONST) {
+		return condition->imm!=0 ? iftrue : iffalse;
+	}
+	for (size_t s=0; s<selects.size(); s++) {
+		if (selects[s]->args[1]==iftrue && selects[s]->args[2]==iffalse) {
+			return selects[s];
+		}
+	}
+	Instruction* select=Emit(OP_SELECT, iftrue->type, condition, iftrue);
+	select->args.push_back(iffalse);
+	select->line=condition->line;
+	selects.push_back(select);
+	return select;
+}
+
+// If-conversion : "IF c THEN x := e1 ELSE x := e2" (or an IF without ELSE) whose arms only compute a few values
+// becomes straight-line code. Both arms are computed before the branch, and each PHI of the join is replaced by
+// a SELECT of the two values, generated with cmov. A branch that depends on the data mispredicts about half the time,
+// which costs more than computing the MaxConverted operations of the other arm. Inner IFs are converted first,
+// so an arm that contained one can be converted too.
+void IfConversion(void) {
+	PassSet<Block*> removed;
+	for (size_t b=Blocks.size(); b>0; b--) {
+		Block* block=Blocks[b-1];
+		Instruction* branch=block->code.back();
+		if (removed.count(block) || branch->op!=OP_BRANCH) {
+			continue;
+		}
+		Block* arms[2]={block->succs[0], block->succs[1]};	// Taken when the condition is TRUE, FALSE
+		Block* join;
+		if (arms[0]->succs.size()==1 && arms[1]->succs.size()==1 && arms[0]->succs[0]==arms[1]->succs[0]) {
+			join=arms[0]->succs[0];
+		}
+		else if (arms[0]->succs.size()==1 && arms[0]->succs[0]==arms[1]) {
+			join=arms[1];
+			arms[1]=NULL;
+		}
+		else if (arms[1]->succs.size()==1 && arms[1]->succs[0]==arms[0]) {
+			join=arms[0];
+			arms[0]=NULL;
+		}
+		else {
+			continue;
+		}
+		size_t cost=0;
+		if (join==block || join->preds.size()!=2 || join==Blocks[0]
+			|| !IsSimpleArm(arms[0], join, cost) || !IsSimpleArm(arms[1], join, cost) || cost>MaxConverted) {
+			continue;
+		}
+		size_t p[2];								// Index of each side in the predecessors of the join
+		for (int a=0; a<2; a++) {
+			p[a]=find(join->preds.begin(), join->preds.end(), arms[a]!=NULL ? arms[a] : block)-join->preds.begin();
+		}
+		Instruction* condition=branch->args[0];
+		block->code.pop_back();						// The branch
+		for (int a=0; a<2; a++) {					// Both arms are computed
+			for (size_t i=0; arms[a]!=NULL && i+1<arms[a]->code.size(); i++) {
+				Instruction* instruction=arms[a]->code[i];
+				instruction->block=block;
+				block->code.push_back(instruction);
+			}
+			if (arms[a]!=NULL) {
+				removed.insert(arms[a]);
+			}
+		}
+		CurrentBlock=block;
+		PassVector<Instruction*> selects;			// SELECTs already made, reused for equal operands
+		for (size_t i=0; i<join->phis.size(); i++) {
+			Instruction* phi=join->phis[i];
+			phi->replacement=Select(selects, condition, Resolve(phi->args[p[0]]), Resolve(phi->args[p[1]]));
+		}
+		CurrentBlock=NULL;
+
+		join->phis.clear();							// The join becomes the end of the block
+		for (size_t i=0; i<join->code.size(); i++) {
+			join->code[i]->block=block;
+			block->code.push_back(join->code[i]);
+		}
+		block->succs=join->succs;
+		for (size_t s=0; s<join->succs.size(); s++) {
+			*find(join->succs[s]->preds.begin(), join->succs[s]->preds.end(), join)=block;
+		}
+		removed.insert(join);
+	}
+	ArenaVector<Block*> kept;
+	for (size_t b=0; b<Blocks.size(); b++) {
+		if (!removed.count(Blocks[b])) {
+			kept.push_back(Blocks[b]);
+		}
+	}
+	Blocks=kept;
+	ResolveOperands();
+}
+
+void Optimize(void) {
+	static void (*const Passes[])(void)={
+		GlobalValueNumbering,
+		LoopInvariantCodeMotion,
+		GlobalValueNumbering,						// Values hoisted from different branches may be the same
+		DeadCodeElimination,
+		RemoveEmptyBlocks,
+		IfConversion,
+		RotateLoops
+	};
+	for (size_t p=0; p<sizeof(Passes)/sizeof(Passes[0]); p++) {
+		Passes[p]();
+		ResetArena(PassArena);						// The tables of the pass are no longer used
+	}
+}
@@ -0,0 +1,151 @@
+// parallel.c : runtime of the PARALLEL FOR loops, linked with the compiled programs
+// Build with "gcc -O2 -c parallel.c"
+// The threads are created by the first PARALLEL FOR : PASCAL_THREADS threads, or one per core, including the thread
+// of main. The iterations of a loop are shared into one range per thread, and each thread runs chunks of its own
+// range. A thread whose range is empty steals the second half of the range of another one, so that the threads
+// stay busy until the end when the iterations do not all take the same time.
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef void (*Body)(unsigned long long first, unsigned long long end);	// Runs the iterations first to end-1
+
+struct Range {										// Iterations left to a thread
+	pthread_mutex_t lock;
+	unsigned long long next, end;
+} __attribute__((aligned(64)));						// One cache line each : the threads do not share them
+
+static struct Range* Ranges;
+static int Workers=0;								// Threads, including the thread of main
+static Body Current;								// Body of the loop being run
+static unsigned long long Grain;					// Iterations of a chunk
+static unsigned long Generation=0;					// Number of loops started
+static int Running;									// Threads of the pool still working on the current loop
+static pthread_mutex_t Lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Start=PTHREAD_COND_INITIALIZER;
+static pthread_cond_t Done=PTHREAD_COND_INITIALIZER;
+
+// Take the next chunk of the w-th range
+static int Take(int w, unsigned long long* first, unsigned long long* end) {
+	struct Range* range=&Ranges[w];
+	int found=0;
+	pthread_mutex_lock(&range->lock);
+	if (range->next<range->end) {
+		*first=range->next;
+		*end=range->end-range->next>Grain ? range->next+Grain : range->end;
+		range->next=*end;
+		found=1;
+	}
+	pthread_mutex_unlock(&range->lock);
+	return found;
+}
+
+// Move the second half of the range of another thread to the w-th range, which is empty
+static int Steal(int w) {
+	for (int i=1; i<Workers; i++) {
+		struct Range* victim=&Ranges[(w+i)%Workers];
+		unsigned long long first=0, end=0;
+		pthread_mutex_lock(&victim->lock);
+		if (victim->next<victim->end && victim->end-victim->next>Grain) {	// Its last chunk is left to it
+			first=victim->next+(victim->end-victim->next)/2;
+			end=victim->end;
+			victim->end=first;
+		}
+		pthread_mutex_unlock(&victim->lock);
+		if (first<end) {
+			pthread_mutex_lock(&Ranges[w].lock);
+			Ranges[w].next=first;
+			Ranges[w].end=end;
+			pthread_mutex_unlock(&Ranges[w].lock);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void Work(int w) {
+	unsigned long long first, end;
+	do {
+		while (Take(w, &first, &end)) {
+			Current(first, end);
+		}
+	}
+	while (Steal(w));
+}
+
+static void* Worker(void* argument) {
+	int w=(int) (long) argument;
+	unsigned long seen=0;							// Last loop worked on
+	for (;;) {
+		pthread_mutex_lock(&Lock);
+		while (Generation==seen) {
+			pthread_cond_wait(&Start, &Lock);
+		}
+		seen=Generation;
+		pthread_mutex_unlock(&Lock);
+		Work(w);
+		pthread_mutex_lock(&Lock);
+		if (--Running==0) {
+			pthread_cond_signal(&Done);
+		}
+		pthread_mutex_unlock(&Lock);
+	}
+	return NULL;
+}
+
+static void Initialize(void) {
+	const char* threads=getenv("PASCAL_THREADS");
+	int wanted=threads!=NULL ? atoi(threads) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (wanted<1) {
+		wanted=1;
+	}
+	if (wanted>256) {
+		wanted=256;
+	}
+	Ranges=aligned_alloc(64, wanted*sizeof(struct Range));
+	for (int w=0; w<wanted; w++) {
+		pthread_mutex_init(&Ranges[w].lock, NULL);
+		Ranges[w].next=Ranges[w].end=0;
+	}
+	Workers=1;
+	for (int w=1; w<wanted; w++) {					// With fewer threads if some cannot be created
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, Worker, (void*) (long) w)!=0) {
+			break;
+		}
+		pthread_detach(thread);
+		Workers++;
+	}
+}
+
+// Called by the generated code : runs body(first, end) on pieces of [first, end), and returns when they are all done
+void pascal_parallel_for(Body body, unsigned long long first, unsigned long long end) {
+	if (first>=end) {
+		return;
+	}
+	if (Workers==0) {
+		Initialize();
+	}
+	unsigned long long count=end-first, share=count/Workers;
+	Grain=count/(Workers*8ULL);						// A few chunks per thread : steals are rare, REDUCE combines a few values
+	if (Grain==0) {
+		Grain=1;
+	}
+	for (int w=0; w<Workers; w++) {					// The threads of the pool wait : the ranges are not locked
+		Ranges[w].next=first+w*share;
+		Ranges[w].end=w==Workers-1 ? end : first+(w+1)*share;
+	}
+	pthread_mutex_lock(&Lock);
+	Current=body;
+	Running=Workers-1;
+	Generation++;
+	pthread_cond_broadcast(&Start);
+	pthread_mutex_unlock(&Lock);
+	Work(0);										// The thread of main works too
+	pthread_mutex_lock(&Lock);
+	while (Running>0) {
+		pthread_cond_wait(&Done, &Lock);
+	}
+	pthread_mutex_unlock(&Lock);
+}
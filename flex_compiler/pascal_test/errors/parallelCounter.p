@@ -0,0 +1,8 @@
+VAR     i : INTEGER.
+
+(* The iterations of a PARALLEL FOR are shared between the threads before they start *)
+
+PARALLEL FOR i := 0 TO 100 DO
+    i := i + 1;
+
+DISPLAY i.
@@ -0,0 +1,10 @@
+VAR     i,j,s : INTEGER.
+
+(* The threads of the runtime all run the iterations of the outer loop *)
+
+s:=0;
+PARALLEL FOR i := 0 TO 100 REDUCE + s DO
+    PARALLEL FOR j := 0 TO 100 DO
+        s := s + i*j;
+
+DISPLAY s.
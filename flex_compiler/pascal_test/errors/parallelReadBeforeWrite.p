@@ -0,0 +1,9 @@
+VAR     i,t : INTEGER.
+
+(* 't' is private to each iteration : its value before the assignment would come from another iteration *)
+
+t:=0;
+PARALLEL FOR i := 0 TO 100 DO
+    t := t + i;
+
+DISPLAY t.
@@ -0,0 +1,10 @@
+VAR     i,s : INTEGER.
+
+(* The FOR would increment 's' at each iteration, and give it the end value *)
+
+s:=0;
+PARALLEL FOR i := 0 TO 100 REDUCE + s DO
+    FOR s := s + 1 TO 10 DO
+        DISPLAY i;
+
+DISPLAY s.
@@ -0,0 +1,9 @@
+VAR     i,s : INTEGER.
+
+(* 's' is reduced with '+' : it cannot be multiplied *)
+
+s:=1;
+PARALLEL FOR i := 1 TO 10 REDUCE + s DO
+    s := s * i;
+
+DISPLAY s.
@@ -0,0 +1,12 @@
+VAR     i,s : INTEGER.
+
+(* The value of a REDUCE variable is only known once every iteration is done *)
+
+s:=0;
+PARALLEL FOR i := 0 TO 100 REDUCE + s DO
+BEGIN
+    s := s + i;
+    DISPLAY s
+END;
+
+DISPLAY s.
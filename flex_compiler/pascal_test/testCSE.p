@@ -0,0 +1,25 @@
+VAR     a,b,c,i : INTEGER;
+        x,y : DOUBLE.
+
+a:=6;
+b:=7;
+x:=1.5;
+
+(* a*b and x*x are computed once *)
+
+c := a*b + a*b;
+DISPLAY c;
+DISPLAY b*a - a*b;
+y := x*x + x*x*2.0;
+DISPLAY y;
+
+FOR i := 0 TO 5 DO
+BEGIN
+    c := c + (a+i)*(a+i);
+    IF a+i > 8 THEN
+        c := c - (a+i)
+END;
+
+DISPLAY c;
+DISPLAY a < b;
+DISPLAY b > a.
@@ -0,0 +1,45 @@
+VAR     a,b,m,n,q,i : INTEGER;
+        x,y : DOUBLE;
+        c : CHAR;
+        t : BOOLEAN.
+
+(* Each IF only computes values and assigns variables : it becomes straight-line code with cmov *)
+
+FOR i := 0 TO 6 DO
+BEGIN
+    a := i*3 % 7;
+    b := i*5 % 4;
+    IF a > b THEN
+        m := a
+    ELSE
+        m := b;
+    IF a < b THEN
+        n := n + a;
+    IF a == b THEN BEGIN
+        x := x + 1.5;
+        c := 'e'
+    END
+    ELSE BEGIN
+        x := x * 2.0;
+        c := 'd'
+    END;
+    IF m > 3 THEN
+        IF n > 2 THEN
+            y := y + 1.0
+        ELSE
+            y := y - 1.0;
+    t := a > 2;
+    IF t THEN
+        t := b > 1;
+    (* The division is only made when b is not zero : it stays behind the branch *)
+    IF b != 0 THEN
+        q := q + a/b;
+    DISPLAY m;
+    DISPLAY c;
+    DISPLAY t
+END;
+
+DISPLAY n;
+DISPLAY q;
+DISPLAY x;
+DISPLAY y.
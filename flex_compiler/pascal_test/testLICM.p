@@ -0,0 +1,35 @@
+VAR     a,b,c,i,j,s : INTEGER;
+        x,y : DOUBLE.
+
+FOR i := 0 TO 4 DO
+    a := a + 1;
+b := a + 1;
+x := 0.5;
+i := 0;
+
+(* a*b, a+b and x*2.0 do not change in the loops : they are computed before them *)
+
+WHILE i < a*b DO
+BEGIN
+    s := s + (a+b)*i;
+    y := y + x*2.0;
+    i := i + 1
+END;
+
+DISPLAY s;
+DISPLAY y;
+
+(* b/c is only computed when the loop runs : c is zero, it is not taken out of the loop *)
+
+WHILE j < c DO
+BEGIN
+    s := s + b/c;
+    j := j + 1
+END;
+
+FOR i := 0 TO 3 DO
+    FOR j := 0 TO a-1 DO
+        s := s + a*b*i + j;
+
+DISPLAY s;
+DISPLAY i*j.
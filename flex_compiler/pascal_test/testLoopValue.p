@@ -0,0 +1,16 @@
+VAR     i,a,s : INTEGER.
+
+a:=3;
+i:=0;
+s:=1;
+
+(* i*a is computed by the test of the loop, which is placed after the body, and used by the body *)
+
+WHILE i*a < 12 DO
+BEGIN
+    DISPLAY s*s+1;
+    s := s + i*a;
+    i := i + 1
+END;
+
+DISPLAY s.
@@ -0,0 +1,19 @@
+VAR     a,b,z : DOUBLE;
+        i : INTEGER.
+
+z := 1.0;
+FOR i := 0 TO 4 DO
+    z := z - 0.25;
+a := z/z;
+b := 1.0;
+
+(* a is NaN : like ucomisd, == < <= are TRUE and != > >= are FALSE, so a > b is not b < a *)
+
+DISPLAY a == a;
+DISPLAY a != a;
+DISPLAY a > b;
+DISPLAY b < a;
+DISPLAY a >= b;
+DISPLAY b <= a;
+DISPLAY b > a;
+DISPLAY a < b.
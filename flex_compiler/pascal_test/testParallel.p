@@ -0,0 +1,39 @@
+VAR     i,j,s,p,t : INTEGER;
+        all,any : BOOLEAN;
+        d : DOUBLE.
+
+s:=0;
+p:=1;
+all:=TRUE;
+any:=FALSE;
+d:=1.0;
+
+PARALLEL FOR i := 0 TO 100000 REDUCE + s, || any, && all DO
+BEGIN
+    t := i % 7;
+    s := s + t*t;
+    any := any || (i == 4242);
+    all := all && (t < 7)
+END;
+
+DISPLAY s;
+DISPLAY any;
+DISPLAY all;
+DISPLAY i;
+
+PARALLEL FOR i := 20 DOWNTO 10 REDUCE * p, * d DO
+BEGIN
+    IF i % 5 == 0 THEN
+        p := p * i;
+    d := d * 2.0
+END;
+
+DISPLAY p;
+DISPLAY d;
+
+s:=0;
+PARALLEL FOR i := 0 TO 300 REDUCE + s DO
+    FOR j := 0 TO i DO
+        s := s + j;
+
+DISPLAY s.
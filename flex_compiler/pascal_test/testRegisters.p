@@ -0,0 +1,25 @@
+VAR     a,b,c,d,e,f,g,h,i : INTEGER;
+        x0,x1,x2,x3,x4,x5,x6,x7,x8,x9 : DOUBLE;
+        y0,y1,y2,y3,y4,y5,y6,y7 : DOUBLE.
+
+(* More values are live in the loop than there are registers : some of them go to their slot *)
+
+a:=1; b:=2; c:=3; d:=4; e:=5; f:=6; g:=7; h:=8;
+x0:=0.5; x1:=1.5; x2:=2.5; x3:=3.5; x4:=4.5; x5:=5.5; x6:=6.5; x7:=7.5; x8:=8.5; x9:=9.5;
+y0:=0.25; y1:=1.25; y2:=2.25; y3:=3.25; y4:=4.25; y5:=5.25; y6:=6.25; y7:=7.25;
+
+FOR i := 0 TO 10 DO
+BEGIN
+    a := a + b; b := b + c; c := c + d; d := d + e;
+    e := e + f; f := f + g; g := g + h; h := h + i;
+    x0 := x0 + x1; x1 := x1 + x2; x2 := x2 + x3; x3 := x3 + x4; x4 := x4 + x5;
+    x5 := x5 + x6; x6 := x6 + x7; x7 := x7 + x8; x8 := x8 + x9; x9 := x9 + y0;
+    y0 := y0 + y1; y1 := y1 + y2; y2 := y2 + y3; y3 := y3 + y4;
+    y4 := y4 + y5; y5 := y5 + y6; y6 := y6 + y7; y7 := y7 * 0.5;
+    IF i % 5 == 0 THEN
+        DISPLAY a + b + c + d + e + f + g + h
+END;
+
+DISPLAY a; DISPLAY b; DISPLAY c; DISPLAY d; DISPLAY e; DISPLAY f; DISPLAY g; DISPLAY h;
+DISPLAY x0 + x1 + x2 + x3 + x4 + x5 + x6 + x7 + x8 + x9;
+DISPLAY y0 + y1 + y2 + y3 + y4 + y5 + y6 + y7.
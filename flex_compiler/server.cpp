@@ -0,0 +1,247 @@
+// server.cpp : compile server listening on a Unix domain socket
+// Build with "g++ -c server.cpp"
+// "./compiler --server [socket]" starts a pool of worker processes (one per core, at least MinimumWorkers) that
+// accept the clients on the same socket. Each worker compiles the programs of its clients one after the other :
+// the lexer and the memory of the previous compilations are reused instead of starting a new process. A client
+// that sends nothing for RequestSeconds is dropped, so it only holds one worker for that time.
+// A program run by --interpret runs in a child process of the worker, stopped after InterpretSeconds, so that a
+// program that never ends does not keep the other clients waiting.
+
+#include "server.h"
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/un.h>
+
+using namespace std;
+
+static const unsigned int InterpretSeconds=10;		// Time given to a program run by --interpret
+static const unsigned int RequestSeconds=10;		// Time a client may stay silent while it sends its request
+static const long MinimumWorkers=4;					// Even on one core : a worker may be waiting for a slow client
+static int Client;									// Client of the child process running a program
+static string TimeLimitFrames;						// What the child sends when it runs out of time
+
+static bool ReadAll(int fd, string& data) {
+	char buffer[65536];
+	ssize_t length;
+	while ((length=read(fd, buffer, sizeof(buffer)))!=0) {
+		if (length<0) {
+			if (errno==EINTR) continue;
+			return false;
+		}
+		data.append(buffer, length);
+	}
+	return true;
+}
+
+static bool WriteAll(int fd, const char* data, size_t size) {
+	while (size>0) {
+		ssize_t length=write(fd, data, size);
+		if (length<0) {
+			if (errno==EINTR) continue;
+			return false;
+		}
+		data+=length;
+		size-=length;
+	}
+	return true;
+}
+
+static string Frame(CHANNEL channel, const string& data) {
+	uint32_t length=htonl(data.size());
+	return string(1, (char) channel)+string((const char*) &length, sizeof(length))+data;
+}
+
+static bool SendFrame(int fd, CHANNEL channel, const string& data) {
+	string frame=Frame(channel, data);
+	return WriteAll(fd, frame.data(), frame.size());
+}
+
+// SIGALRM in the child process : the program is stopped, the client is told so
+static void TimeLimit(int) {
+	WriteAll(Client, TimeLimitFrames.data(), TimeLimitFrames.size());
+	_exit(0);
+}
+
+// Compile one program, with stdout and stderr of the compiler captured for the client
+static void Answer(int client) {
+	static ostringstream output, diagnostics;		// Kept between requests
+	string request;
+	int status;
+	bool interpret=false;
+	if (!ReadAll(client, request)) {
+		if (errno==EAGAIN || errno==EWOULDBLOCK) {
+			SendFrame(client, DIAGNOSTICS, "Request timeout: nothing received for "+to_string(RequestSeconds)+" seconds.\n");
+			SendFrame(client, STATUS, "-1");
+		}
+		return;
+	}
+
+	vector<string> options;							// Number of options, then each option ended by a NUL character
+	size_t next=request.find('\n');
+	int count=next==string::npos ? -1 : atoi(request.substr(0, next).c_str());
+	for (next++; count>0 && next<request.size(); count--) {
+		size_t end=request.find('\0', next);
+		if (end==string::npos) {
+			break;
+		}
+		options.push_back(request.substr(next, end-next));
+		interpret=interpret || options.back()=="--interpret";
+		next=end+1;
+	}
+	if (count!=0) {
+		SendFrame(client, DIAGNOSTICS, "Malformed request: options expected.\n");
+		SendFrame(client, STATUS, "-1");
+		return;
+	}
+	if (interpret) {								// The child answers, the server goes on with the next client
+		pid_t child=fork();
+		if (child<0) {
+			SendFrame(client, DIAGNOSTICS, string("Cannot run the program: fork: ")+strerror(errno)+"\n");
+			SendFrame(client, STATUS, "-1");
+		}
+		if (child!=0) {
+			return;
+		}
+		Client=client;
+		TimeLimitFrames=Frame(DIAGNOSTICS, "Time limit exceeded: the program was stopped after "+to_string(InterpretSeconds)+" seconds.\n")
+			+Frame(STATUS, "-1");
+		signal(SIGALRM, TimeLimit);
+		alarm(InterpretSeconds);
+	}
+
+	vector<char*> argv;
+	argv.push_back((char*) "compiler");
+	for (size_t i=0; i<options.size(); i++) {
+		argv.push_back((char*) options[i].c_str());
+	}
+	argv.push_back(NULL);
+
+	istringstream source(request.substr(next));
+	output.str("");
+	diagnostics.str("");
+	streambuf* out=cout.rdbuf(output.rdbuf());
+	streambuf* err=cerr.rdbuf(diagnostics.rdbuf());
+	try {
+		status=CompileRequest(source, argv.size()-1, argv.data());
+	}
+	catch (exception& e) {							// Such as a literal too large for stoull
+		cerr<<"Internal error: "<<e.what()<<endl;
+		status=-1;
+	}
+	cout.rdbuf(out);
+	cerr.rdbuf(err);
+
+	if (interpret) {
+		alarm(0);
+	}
+	SendFrame(client, OUTPUT, output.str()) && SendFrame(client, DIAGNOSTICS, diagnostics.str()) && SendFrame(client, STATUS, to_string(status));
+	if (interpret) {
+		_exit(0);
+	}
+}
+
+// Accept clients forever in a worker process, one compilation at a time
+static void Work(int server, pid_t parent) {
+	struct timeval timeout={RequestSeconds, 0};
+	prctl(PR_SET_PDEATHSIG, SIGTERM);				// Stopping the server stops its workers
+	if (getppid()!=parent) {						// Stopped before prctl
+		_exit(0);
+	}
+	signal(SIGCHLD, SIG_IGN);						// The children running programs are not waited for
+	while (true) {
+		int client=accept(server, NULL, NULL);
+		if (client<0) {
+			if (errno==EINTR) continue;
+			cerr<<"accept: "<<strerror(errno)<<endl;
+			_exit(1);
+		}
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		Answer(client);
+		close(client);
+	}
+}
+
+// Start the workers on the socket, and replace a worker that crashes
+int Serve(const char* path) {
+	struct sockaddr_un address;
+	int server=socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server<0) {
+		cerr<<"socket: "<<strerror(errno)<<endl;
+		return -1;
+	}
+	if (strlen(path)>=sizeof(address.sun_path)) {
+		cerr<<"Socket path too long: "<<path<<endl;
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family=AF_UNIX;
+	strcpy(address.sun_path, path);
+	struct stat file;
+	if (lstat(path, &file)==0) {					// Left by a previous server
+		if (!S_ISSOCK(file.st_mode)) {
+			cerr<<"Cannot listen on "<<path<<": not a socket, it is left as it is"<<endl;
+			return -1;
+		}
+		unlink(path);
+	}
+	if (bind(server, (struct sockaddr*) &address, sizeof(address))<0 || listen(server, SOMAXCONN)<0) {
+		cerr<<"Cannot listen on "<<path<<": "<<strerror(errno)<<endl;
+		return -1;
+	}
+	signal(SIGPIPE, SIG_IGN);						// A client that leaves early must not kill the server
+	long cores=sysconf(_SC_NPROCESSORS_ONLN);
+	pid_t parent=getpid();
+	vector<pid_t> workers(cores>MinimumWorkers ? cores : MinimumWorkers, 0);
+	cerr<<"Compile server listening on "<<path<<" with "<<workers.size()<<" workers"<<endl;
+	while (true) {
+		size_t running=0;
+		for (size_t w=0; w<workers.size(); w++) {
+			if (workers[w]==0) {
+				pid_t worker=fork();
+				if (worker==0) {
+					Work(server, parent);
+				}
+				if (worker<0) {
+					cerr<<"Cannot start a worker: fork: "<<strerror(errno)<<endl;
+				}
+				else {
+					workers[w]=worker;
+				}
+			}
+			running+=workers[w]!=0;
+		}
+		if (running==0) {
+			return -1;
+		}
+		int status;
+		pid_t worker=wait(&status);
+		if (worker<0) {
+			if (errno==EINTR) continue;
+			cerr<<"wait: "<<strerror(errno)<<endl;
+			return -1;
+		}
+		for (size_t w=0; w<workers.size(); w++) {
+			if (workers[w]!=worker) continue;
+			workers[w]=0;
+			if (!WIFSIGNALED(status)) {				// accept failed : the other workers are stopped with the server
+				for (size_t other=0; other<workers.size(); other++) {
+					if (workers[other]>0) kill(workers[other], SIGTERM);
+				}
+				return -1;
+			}
+			cerr<<"Worker "<<worker<<" stopped by signal "<<WTERMSIG(status)<<", it is replaced"<<endl;
+		}
+	}
+}
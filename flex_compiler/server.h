@@ -0,0 +1,18 @@
+// server.h : shared definitions for server.cpp, client.cpp and compiler.cpp
+// The compile server receives the number of options of the compiler on one line, then each option ended by
+// a NUL character, then the source of the program (until the client shuts down its side of the connection). It answers with frames made of a channel,
+// a 32-bit length (network byte order) and the data.
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <iostream>
+
+#define DEFAULT_SOCKET "/tmp/pascal-compiler.socket"	// Used when no socket is given to --server or to the client
+
+enum CHANNEL {OUTPUT='O', DIAGNOSTICS='E', STATUS='X'};	// What ./compiler writes on stdout, on stderr, and its exit status
+
+int Serve(const char* path);							// server.cpp
+int CompileRequest(std::istream& source, int argc, char** argv);	// compiler.cpp
+
+#endif
@@ -0,0 +1,355 @@
+// vm.cpp : register-based bytecode compiled from the SSA intermediate representation, and its interpreter
+// Build with "g++ -O2 -c vm.cpp"
+// "./compiler --interpret < program.p" runs the program without assembling and linking it.
+// Every SSA value has its own register. Constants are loaded in their registers before the program starts,
+// so the bytecode only contains operations between registers. Each PHI has an input register
+// written by its predecessors, copied into the PHI's register at the start of its block.
+// The interpreter dispatches with computed gotos (a GCC extension) : each handler jumps to the next one.
+// Each function (main and the bodies of the PARALLEL FOR loops) has its own bytecode and registers. The .data
+// variables are kept in an array : the bodies read them there, and the iterations run one after the other.
+
+#include "ir.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+enum BYTECODE {
+	BC_MOVE,										// r[a] = r[b]
+	BC_ADD, BC_SUB, BC_MUL, BC_DIV, BC_MOD,			// r[a] = r[b] op r[c], unsigned 64-bit integers
+	BC_FADD, BC_FSUB, BC_FMUL, BC_FDIV,				// r[a] = r[b] op r[c], doubles
+	BC_EQU, BC_DIFF, BC_INF, BC_SUP, BC_INFE, BC_SUPE,			// r[a] = r[b] op r[c] ? TRUE : FALSE, unsigned 64-bit integers
+	BC_FEQU, BC_FDIFF, BC_FINF, BC_FSUP, BC_FINFE, BC_FSUPE,	// r[a] = r[b] op r[c] ? TRUE : FALSE, doubles
+	BC_DISPLAYI, BC_DISPLAYB, BC_DISPLAYC, BC_DISPLAYD,			// print r[a] and a newline character
+	BC_JUMP,										// pc = a
+	BC_BRANCH,										// pc = r[a] ? b : c
+	BC_CMOV,										// if (r[b]) r[a] = r[c]
+	BC_LOAD,										// r[a] = variable b
+	BC_STORE,										// variable a = r[b]
+	BC_PARALLEL,									// run the function c for the iterations r[a] to r[b] (excluded)
+	BC_REDUCE,										// variable a = variable a op r[b], where op is the bytecode c
+	BC_RET
+};
+
+struct Bytecode {
+	unsigned int op, a, b, c;
+};
+
+struct Code {										// A compiled function
+	vector<Bytecode> program;
+	vector<unsigned long long> registers;			// Initial content of the registers (constants)
+	unsigned int arguments[2];						// Registers of the first iteration and of the end of the range
+};
+
+static vector<Bytecode> Program;					// The bytecode of the function being compiled
+static vector<unsigned long long> Registers;		// Initial content of its registers
+static map<Instruction*, unsigned int> Register;	// Register of each value
+static map<Instruction*, unsigned int> PhiInput;	// Register written by the predecessors of a PHI
+static vector<Code> Compiled;						// Every function, main first
+static map<const char*, unsigned int> FunctionIndex;	// Index of each function in Compiled
+static map<const char*, unsigned int> Address;		// Index of each variable in Memory
+static vector<unsigned long long> Memory;			// The .data variables
+
+static void Append(unsigned int op, unsigned int a, unsigned int b=0, unsigned int c=0) {
+	Bytecode bytecode={op, a, b, c};
+	Program.push_back(bytecode);
+}
+
+static unsigned int NewRegister(unsigned long long value) {
+	Registers.push_back(value);
+	return Registers.size()-1;
+}
+
+// Before leaving 'block', give their value to the PHIs of its successors
+static void AppendPhiMoves(Block* block) {
+	for (size_t s=0; s<block->succs.size(); s++) {
+		Block* succ=block->succs[s];
+		size_t p=0;
+		while (succ->preds[p]!=block) {
+			p++;
+		}
+		for (size_t i=0; i<succ->phis.size(); i++) {
+			Append(BC_MOVE, PhiInput[succ->phis[i]], Register[succ->phis[i]->args[p]]);
+		}
+	}
+}
+
+static void AppendInstruction(Instruction* instruction, vector<pair<size_t, Block*> >& fixups, Block* next) {
+	Block* block=instruction->block;
+	unsigned int a=Register[instruction];
+	unsigned int b=instruction->args.size()>0 ? Register[instruction->args[0]] : 0;
+	unsigned int c=instruction->args.size()>1 ? Register[instruction->args[1]] : 0;
+	bool real=instruction->args.size()>0 && instruction->args[0]->type==DOUBLE;
+	switch (instruction->op) {
+		case OP_CONST:								// Already in its register
+		case OP_ARG:								// Written by BC_PARALLEL
+			break;
+		case OP_LOAD:
+			Append(BC_LOAD, a, Address[instruction->var]);
+			break;
+		case OP_STORE:
+			Append(BC_STORE, Address[instruction->var], b);
+			break;
+		case OP_PARALLEL:
+			Append(BC_PARALLEL, b, c, FunctionIndex[instruction->var]);
+			break;
+		case OP_REDUCE:
+			switch (instruction->imm) {
+				case OP_ADD: case OP_OR:
+					Append(BC_REDUCE, Address[instruction->var], b, real ? BC_FADD : BC_ADD);
+					break;
+				default:
+					Append(BC_REDUCE, Address[instruction->var], b, real ? BC_FMUL : BC_MUL);
+			}
+			break;
+		case OP_ADD: case OP_OR:
+			Append(real ? BC_FADD : BC_ADD, a, b, c);
+			break;
+		case OP_SUB:
+			Append(real ? BC_FSUB : BC_SUB, a, b, c);
+			break;
+		case OP_MUL: case OP_AND:
+			Append(real ? BC_FMUL : BC_MUL, a, b, c);
+			break;
+		case OP_DIV:
+			Append(real ? BC_FDIV : BC_DIV, a, b, c);
+			break;
+		case OP_MOD:
+			Append(BC_MOD, a, b, c);
+			break;
+		case OP_EQU: case OP_DIFF: case OP_INF: case OP_SUP: case OP_INFE: case OP_SUPE:
+			Append((real ? BC_FEQU : BC_EQU)+(instruction->op-OP_EQU), a, b, c);
+			break;
+		case OP_SELECT:								// r[a] = r[args[2]], then r[args[1]] if the condition is TRUE
+			Append(BC_MOVE, a, Register[instruction->args[2]]);
+			Append(BC_CMOV, a, b, c);
+			break;
+		case OP_DISPLAY:
+			switch (instruction->type) {
+				case INTEGER: Append(BC_DISPLAYI, b); break;
+				case BOOLEAN: Append(BC_DISPLAYB, b); break;
+				case CHAR: Append(BC_DISPLAYC, b); break;
+				case DOUBLE: Append(BC_DISPLAYD, b); break;
+				default: break;
+			}
+			break;
+		case OP_JUMP:
+			AppendPhiMoves(block);
+			if (block->succs[0]!=next) {			// No jump to the next block
+				fixups.push_back(make_pair(Program.size(), block->succs[0]));
+				Append(BC_JUMP, 0);
+			}
+			break;
+		case OP_BRANCH:
+			AppendPhiMoves(block);
+			fixups.push_back(make_pair(Program.size(), block));
+			Append(BC_BRANCH, b);
+			break;
+		case OP_RET:
+			Append(BC_RET, 0);
+			break;
+		default:
+			break;
+	}
+}
+
+// Translate the IR of the selected function into bytecode
+static void CompileBytecode(Code& code) {
+	map<Block*, unsigned int> start;				// First bytecode of each block
+	vector<pair<size_t, Block*> > fixups;			// Jumps (with their target) and branches (with their block) to complete
+	Program.clear();
+	Registers.clear();
+	Register.clear();
+	PhiInput.clear();
+	code.arguments[0]=code.arguments[1]=NewRegister(0);	// Unless the function reads them
+	for (size_t b=0; b<Blocks.size(); b++) {
+		for (size_t i=0; i<Blocks[b]->phis.size(); i++) {
+			Register[Blocks[b]->phis[i]]=NewRegister(0);
+			PhiInput[Blocks[b]->phis[i]]=NewRegister(0);
+		}
+		for (size_t i=0; i<Blocks[b]->code.size(); i++) {
+			Instruction* instruction=Blocks[b]->code[i];
+			if (HasValue(instruction->op)) {
+				Register[instruction]=NewRegister(instruction->op==OP_CONST ? instruction->imm : 0);
+			}
+			if (instruction->op==OP_ARG) {
+				code.arguments[instruction->imm]=Register[instruction];
+			}
+		}
+	}
+	for (size_t b=0; b<Blocks.size(); b++) {
+		Block* block=Blocks[b];
+		start[block]=Program.size();
+		for (size_t i=0; i<block->phis.size(); i++) {
+			Append(BC_MOVE, Register[block->phis[i]], PhiInput[block->phis[i]]);
+		}
+		for (size_t i=0; i<block->code.size(); i++) {
+			AppendInstruction(block->code[i], fixups, b+1<Blocks.size() ? Blocks[b+1] : NULL);
+		}
+	}
+	for (size_t f=0; f<fixups.size(); f++) {
+		Bytecode& bytecode=Program[fixups[f].first];
+		if (bytecode.op==BC_JUMP) {
+			bytecode.a=start[fixups[f].second];
+		}
+		else {										// Branches are recorded with their own block
+			bytecode.b=start[fixups[f].second->succs[0]];
+			bytecode.c=start[fixups[f].second->succs[1]];
+		}
+	}
+	code.program.swap(Program);
+	code.registers.swap(Registers);
+}
+
+static inline double D(unsigned long long bits) {
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+static inline unsigned long long Q(double d) {
+	unsigned long long bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+#define TRUTH(condition) ((condition) ? 0xFFFFFFFFFFFFFFFFULL : 0ULL)
+#define UNORDERED(x, y) ((x)!=(x) || (y)!=(y))		// ucomisd sets ZF and CF when a double is NaN
+
+// Same formats as the printf calls of the generated code, written to 'out'
+template<class T> static void Display(ostream& out, const char* format, T value) {
+	char text[512];									// Enough for any double in %lf
+	int length=snprintf(text, sizeof(text), format, value);
+	out.write(text, length);
+}
+
+// Run a function : main, or the body of a PARALLEL FOR for the iterations 'first' to 'end' (excluded).
+// Returns false when the program divides by zero : the native program would be stopped by SIGFPE.
+static bool Run(ostream& out, const Code& function, unsigned long long first, unsigned long long end) {
+	static void* handlers[]={
+		&&move, &&add, &&sub, &&mul, &&div, &&mod, &&fadd, &&fsub, &&fmul, &&fdiv,
+		&&equ, &&diff, &&inf, &&sup, &&infe, &&supe, &&fequ, &&fdiff, &&finf, &&fsup, &&finfe, &&fsupe,
+		&&displayi, &&displayb, &&displayc, &&displayd, &&jump, &&branch, &&cmov,
+		&&load, &&store, &&parallel, &&reduce, &&ret
+	};
+	vector<unsigned long long> registers=function.registers;
+	unsigned long long* r=registers.data();
+	r[function.arguments[0]]=first;
+	r[function.arguments[1]]=end;
+	const Bytecode* code=function.program.data();
+	const Bytecode* pc=code;
+
+#define NEXT() goto *handlers[pc->op]
+#define BINARY(name, expression) name: { unsigned long long x=r[pc->b], y=r[pc->c]; r[pc->a]=(expression); pc++; NEXT(); }
+#define DIVISION(name, expression) name: { unsigned long long x=r[pc->b], y=r[pc->c]; if (y==0) goto zero; r[pc->a]=(expression); pc++; NEXT(); }
+
+	NEXT();
+move:
+	r[pc->a]=r[pc->b];
+	pc++;
+	NEXT();
+	BINARY(add, x+y)
+	BINARY(sub, x-y)
+	BINARY(mul, x*y)
+	DIVISION(div, x/y)
+	DIVISION(mod, x%y)
+	BINARY(fadd, Q(D(x)+D(y)))
+	BINARY(fsub, Q(D(x)-D(y)))
+	BINARY(fmul, Q(D(x)*D(y)))
+	BINARY(fdiv, Q(D(x)/D(y)))
+	BINARY(equ, TRUTH(x==y))
+	BINARY(diff, TRUTH(x!=y))
+	BINARY(inf, TRUTH(x<y))
+	BINARY(sup, TRUTH(x>y))
+	BINARY(infe, TRUTH(x<=y))
+	BINARY(supe, TRUTH(x>=y))
+	BINARY(fequ, TRUTH(D(x)==D(y) || UNORDERED(D(x), D(y))))
+	BINARY(fdiff, TRUTH(!(D(x)==D(y) || UNORDERED(D(x), D(y)))))
+	BINARY(finf, TRUTH(D(x)<D(y) || UNORDERED(D(x), D(y))))
+	BINARY(fsup, TRUTH(D(x)>D(y)))
+	BINARY(finfe, TRUTH(D(x)<=D(y) || UNORDERED(D(x), D(y))))
+	BINARY(fsupe, TRUTH(D(x)>=D(y)))
+displayi:
+	Display(out, "%llu\n", r[pc->a]);
+	pc++;
+	NEXT();
+displayb:
+	out<<(r[pc->a]!=0 ? "TRUE\n" : "FALSE\n");
+	pc++;
+	NEXT();
+displayc:
+	Display(out, "%c\n", (int) (unsigned char) r[pc->a]);
+	pc++;
+	NEXT();
+displayd:
+	Display(out, "%lf\n", D(r[pc->a]));
+	pc++;
+	NEXT();
+jump:
+	pc=code+pc->a;
+	NEXT();
+branch:
+	pc=code+(r[pc->a]!=0 ? pc->b : pc->c);
+	NEXT();
+cmov:
+	if (r[pc->b]!=0) {
+		r[pc->a]=r[pc->c];
+	}
+	pc++;
+	NEXT();
+load:
+	r[pc->a]=Memory[pc->b];
+	pc++;
+	NEXT();
+store:
+	Memory[pc->a]=r[pc->b];
+	pc++;
+	NEXT();
+parallel:											// The iterations run one after the other
+	if (!Run(out, Compiled[pc->c], r[pc->a], r[pc->b])) {
+		return false;
+	}
+	pc++;
+	NEXT();
+reduce:
+	switch (pc->c) {
+		case BC_ADD: Memory[pc->a]+=r[pc->b]; break;
+		case BC_MUL: Memory[pc->a]*=r[pc->b]; break;
+		case BC_FADD: Memory[pc->a]=Q(D(Memory[pc->a])+D(r[pc->b])); break;
+		default: Memory[pc->a]=Q(D(Memory[pc->a])*D(r[pc->b]));
+	}
+	pc++;
+	NEXT();
+ret:
+	out.flush();
+	return true;
+zero:
+	out.flush();
+	cerr<<"Runtime error: division by zero."<<endl;
+	return false;
+
+#undef DIVISION
+#undef BINARY
+#undef NEXT
+}
+
+// Returns false when the program was stopped by an error
+bool Interpret(ostream& out) {
+	Function* selected=CurrentFunction;
+	Address.clear();
+	for (size_t v=0; v<Variables.size(); v++) {
+		Address[Variables[v].first]=v;
+	}
+	Memory.assign(Variables.size(), 0);
+	FunctionIndex.clear();
+	for (size_t f=0; f<Functions.size(); f++) {
+		FunctionIndex[Functions[f]->label]=f;
+	}
+	Compiled.assign(Functions.size(), Code());
+	for (size_t f=0; f<Functions.size(); f++) {
+		SelectFunction(Functions[f]);
+		CompileBytecode(Compiled[f]);
+	}
+	SelectFunction(selected);
+	return Run(out, Compiled[0], 0, 0);
+}